@@ -0,0 +1,191 @@
+//bench-folds compiles and runs fold programs, reporting throughput:
+// ./bench-folds [--threads N] [--repeat R] [--generate COUNT SEED] [--check] [file.folds ...]
+//(e.g., ./bench-folds ../our_problems/*.folds --generate 1000 1)
+//--check also replays each fold-only program as a FoldSequence and checks its land/preimages/bbox
+// answers against the folded Mesh (and a materialized State); it isn't timed.
+
+#include "structures.hpp"
+#include "mesh.hpp"
+#include "program.hpp"
+#include "sequence.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+
+//random fold program: lines through two random points on a grid covering a bit more than the square
+// (so some folds miss the paper and get dropped by the compiler):
+static std::string generate_program(std::mt19937 &rng, uint32_t folds) {
+	std::uniform_int_distribution< int32_t > coord(-4, 28);
+	std::ostringstream out;
+	for (uint32_t i = 0; i < folds; ++i) {
+		int32_t x1, y1, x2, y2;
+		do {
+			x1 = coord(rng); y1 = coord(rng);
+			x2 = coord(rng); y2 = coord(rng);
+		} while (x1 == x2 && y1 == y2);
+		out << "fold " << x1 << "/24," << y1 << "/24 " << x2 << "/24," << y2 << "/24\n";
+	}
+	return out.str();
+}
+
+//compare a FoldSequence's answers with the mesh the same folds built; returns number of mismatches:
+static uint32_t check_sequence(FoldSequence const &seq, Mesh const &mesh, std::string const &name) {
+	uint32_t bad = 0;
+	auto report = [&](std::string const &what) {
+		if (bad < 5) std::cerr << "ERROR: '" << name << "': " << what << std::endl;
+		++bad;
+	};
+
+	K::Point_2 min, max;
+	seq.bbox(&min, &max);
+	CGAL::Gmpq min_x = mesh.destination[0].x();
+	CGAL::Gmpq min_y = mesh.destination[0].y();
+	CGAL::Gmpq max_x = min_x;
+	CGAL::Gmpq max_y = min_y;
+	for (uint32_t v = 0; v < mesh.source.size(); ++v) {
+		K::Point_2 const &s = mesh.source[v];
+		K::Point_2 const &d = mesh.destination[v];
+		if (d.x() < min_x) min_x = d.x();
+		if (d.y() < min_y) min_y = d.y();
+		if (d.x() > max_x) max_x = d.x();
+		if (d.y() > max_y) max_y = d.y();
+		if (seq.land(s) != d) {
+			report("vertex " + std::to_string(v) + " lands away from the mesh.");
+		}
+		auto pre = seq.preimages(d);
+		if (std::find(pre.begin(), pre.end(), s) == pre.end()) {
+			report("vertex " + std::to_string(v) + " missing from the preimages of where it lands.");
+		}
+	}
+	if (min != K::Point_2(min_x, min_y) || max != K::Point_2(max_x, max_y)) {
+		report("bbox doesn't match the mesh.");
+	}
+
+	State state = seq.materialize();
+	for (auto const &facet : state) {
+		for (uint32_t i = 0; i < facet.source.size(); ++i) {
+			K::Point_2 d = facet.destination(i);
+			if (seq.land(facet.source[i]) != d) {
+				report("materialized facet corner lands away from the state.");
+			}
+			if (d.x() < min.x() || d.y() < min.y() || d.x() > max.x() || d.y() > max.y()) {
+				report("materialized facet corner outside bbox.");
+			}
+		}
+	}
+	return bad;
+}
+
+int main(int argc, char **argv) {
+	uint32_t repeat = 1;
+	uint32_t generate = 0;
+	uint32_t seed = 0;
+	bool check = false;
+	std::vector< std::string > files;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			set_parallel_threads(std::atoi(argv[++i]));
+		} else if (arg == "--repeat" && i + 1 < argc) {
+			repeat = std::max(1, std::atoi(argv[++i]));
+		} else if (arg == "--generate" && i + 2 < argc) {
+			generate = std::atoi(argv[++i]);
+			seed = std::atoi(argv[++i]);
+		} else if (arg == "--check") {
+			check = true;
+		} else {
+			files.emplace_back(arg);
+		}
+	}
+	if (files.empty() && generate == 0) {
+		std::cerr << "Usage:\n\t./bench-folds [--threads N] [--repeat R] [--generate COUNT SEED] [--check] [file.folds ...]\n" << std::endl;
+		return 1;
+	}
+
+	//programs to run, as (name, text):
+	std::vector< std::pair< std::string, std::string > > programs;
+	for (auto const &file : files) {
+		std::ifstream in(file);
+		if (!in) {
+			std::cerr << "ERROR: can't read '" << file << "'." << std::endl;
+			return 1;
+		}
+		std::ostringstream text;
+		text << in.rdbuf();
+		programs.emplace_back(file, text.str());
+	}
+	{
+		std::mt19937 rng(seed);
+		for (uint32_t i = 0; i < generate; ++i) {
+			programs.emplace_back("generated-" + std::to_string(i), generate_program(rng, 8));
+		}
+	}
+
+	typedef std::chrono::high_resolution_clock Clock;
+	double compile_seconds = 0.0;
+	double run_seconds = 0.0;
+	uint64_t total_folds = 0;
+	uint64_t total_dropped = 0;
+	uint64_t total_facets = 0;
+	uint32_t checked = 0;
+	uint32_t mismatches = 0;
+	for (uint32_t r = 0; r < repeat; ++r) {
+		for (auto const &program : programs) {
+			auto before = Clock::now();
+			std::istringstream text(program.second);
+			std::unique_ptr< FoldProgram > compiled = FoldProgram::compile(text, program.first, true);
+			auto compiled_at = Clock::now();
+			if (!compiled) {
+				std::cerr << "ERROR: failed to compile '" << program.first << "'." << std::endl;
+				return 1;
+			}
+			Mesh state;
+			compiled->run(state);
+			auto done = Clock::now();
+
+			compile_seconds += std::chrono::duration< double >(compiled_at - before).count();
+			run_seconds += std::chrono::duration< double >(done - compiled_at).count();
+			total_folds += compiled->folds;
+			total_dropped += compiled->dropped;
+			total_facets += state.faces.size();
+			if (r == 0 && program.first.compare(0, 10, "generated-") != 0) {
+				std::cerr << program.first << ": " << compiled->folds << " folds (" << compiled->dropped << " dropped), "
+					<< state.faces.size() << " facets." << std::endl;
+			}
+
+			//only programs that are plain folds of the square have a FoldSequence to compare:
+			if (check && r == 0) {
+				bool plain = true;
+				FoldSequence seq;
+				for (auto const &inst : compiled->instructions) {
+					if (inst.op != FoldInstruction::Fold) {
+						plain = false;
+						break;
+					}
+					for (auto const &f : inst.folds) {
+						seq.fold(f.first, f.second);
+					}
+				}
+				if (plain) {
+					++checked;
+					mismatches += check_sequence(seq, state, program.first);
+				}
+			}
+		}
+	}
+
+	double total = compile_seconds + run_seconds;
+	std::cout << programs.size() * repeat << " programs, " << total_folds << " folds run, " << total_dropped << " dropped, " << total_facets << " facets built." << std::endl;
+	std::cout << "compile: " << compile_seconds << "s, run: " << run_seconds << "s (" << parallel_threads() << " threads)" << std::endl;
+	if (total > 0.0) {
+		std::cout << (programs.size() * repeat) / total << " programs/s, " << total_folds / total << " folds/s" << std::endl;
+	}
+	if (check) {
+		std::cout << "checked " << checked << " programs against FoldSequence: " << mismatches << " mismatches." << std::endl;
+		if (mismatches) return 1;
+	}
+	return 0;
+}
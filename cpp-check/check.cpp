@@ -1,10 +1,15 @@
 //Note: requires CGAL and GMP (for big rationals)
 // ... that makes everything else ~easy like cake~
 //Usage ./check problem solution
+//   or ./check --serve [cache-size]
 
 #include <iostream>
 #include <memory>
 #include <fstream>
+#include <sstream>
+#include <list>
+#include <map>
+#include <unordered_map>
 #include <unordered_set>
 
 #include "structures.hpp"
@@ -13,10 +18,9 @@
 
 // This is an independent copy of the get_score() so that we won't
 // accidentally destroy the correctness of check.cpp.
-CGAL::Gmpq check_solution(Problem const &problem, Solution const &solution) {
+CGAL::Gmpq check_solution(CGAL::Polygon_set_2< K > const &a, Solution const &solution) {
 	//To check this solution we'll use CGAL's polygon set functionality
 	
-	CGAL::Polygon_set_2< K > a = problem.get_silhouette();
 	CGAL::Polygon_set_2< K > b = solution.get_silhouette();
 
 	CGAL::Polygon_set_2< K > a_and_b;
@@ -54,9 +58,302 @@ CGAL::Gmpq check_solution(Problem const &problem, Solution const &solution) {
 	return and_area / or_area;
 }
 
+CGAL::Gmpq check_solution(Problem const &problem, Solution const &solution) {
+	return check_solution(problem.get_silhouette(), solution);
+}
+
+//------------- --serve mode --------------------
+//Reads one request per line on stdin, each a flat JSON object:
+//  {"id": 17, "problem": "problems/prob17", "solution": "path/to/solution"}
+//("problem_text" / "solution_text" may be given instead of paths)
+//and answers each with one line on stdout:
+//  {"id":17,"valid":true,"score":"3/4","approx":0.7500000}
+//  {"id":17,"valid":false,"error":"..."}    -- the solution couldn't be read or isn't valid
+//  {"id":17,"error":"..."}                  -- the request itself was bad (no "valid" field, since nothing was checked)
+//"id" is echoed back as given; it must be a string, number, true, false, or null (otherwise the reply's id is null).
+//Parsed problems (and their silhouettes) are kept in an LRU cache, so repeated checks against one problem don't re-read it.
+
+struct JsonValue {
+	bool is_string = false;
+	std::string text; //decoded contents for strings, raw token otherwise
+};
+
+static bool parse_json_string(std::string const &s, size_t &i, std::string &out) {
+	assert(i < s.size() && s[i] == '"');
+	++i;
+	out.clear();
+	while (i < s.size()) {
+		char c = s[i++];
+		if (c == '"') return true;
+		if (c != '\\') {
+			out += c;
+			continue;
+		}
+		if (i >= s.size()) return false;
+		char e = s[i++];
+		if (e == '"') out += '"';
+		else if (e == '\\') out += '\\';
+		else if (e == '/') out += '/';
+		else if (e == 'b') out += '\b';
+		else if (e == 'f') out += '\f';
+		else if (e == 'n') out += '\n';
+		else if (e == 'r') out += '\r';
+		else if (e == 't') out += '\t';
+		else if (e == 'u') {
+			if (i + 4 > s.size()) return false;
+			uint32_t code = 0;
+			for (uint32_t d = 0; d < 4; ++d) {
+				char h = s[i++];
+				code <<= 4;
+				if (h >= '0' && h <= '9') code |= h - '0';
+				else if (h >= 'a' && h <= 'f') code |= h - 'a' + 10;
+				else if (h >= 'A' && h <= 'F') code |= h - 'A' + 10;
+				else return false;
+			}
+			//(surrogate pairs aren't handled; nothing we read should need them)
+			if (code < 0x80) {
+				out += char(code);
+			} else if (code < 0x800) {
+				out += char(0xc0 | (code >> 6));
+				out += char(0x80 | (code & 0x3f));
+			} else {
+				out += char(0xe0 | (code >> 12));
+				out += char(0x80 | ((code >> 6) & 0x3f));
+				out += char(0x80 | (code & 0x3f));
+			}
+		} else {
+			return false;
+		}
+	}
+	return false;
+}
+
+//only handles flat objects (no nested objects or arrays as values):
+static bool parse_json_object(std::string const &s, std::map< std::string, JsonValue > &obj) {
+	size_t i = 0;
+	auto skip = [&]() {
+		while (i < s.size() && isspace(s[i])) ++i;
+	};
+	skip();
+	if (i >= s.size() || s[i] != '{') return false;
+	++i;
+	skip();
+	if (i < s.size() && s[i] == '}') {
+		++i;
+		skip();
+		return i == s.size();
+	}
+	while (true) {
+		skip();
+		if (i >= s.size() || s[i] != '"') return false;
+		std::string key;
+		if (!parse_json_string(s, i, key)) return false;
+		skip();
+		if (i >= s.size() || s[i] != ':') return false;
+		++i;
+		skip();
+		if (i >= s.size()) return false;
+		JsonValue val;
+		if (s[i] == '"') {
+			val.is_string = true;
+			if (!parse_json_string(s, i, val.text)) return false;
+		} else {
+			size_t start = i;
+			while (i < s.size() && s[i] != ',' && s[i] != '}' && !isspace(s[i])) ++i;
+			val.text = s.substr(start, i - start);
+			if (val.text.empty() || val.text[0] == '{' || val.text[0] == '[') return false;
+		}
+		obj[key] = val;
+		skip();
+		if (i < s.size() && s[i] == ',') {
+			++i;
+			continue;
+		}
+		if (i < s.size() && s[i] == '}') {
+			++i;
+			skip();
+			return i == s.size();
+		}
+		return false;
+	}
+}
+
+//is token (an unquoted value) a JSON number, true, false, or null?
+static bool is_json_literal(std::string const &t) {
+	if (t == "true" || t == "false" || t == "null") return true;
+	size_t i = 0;
+	auto digits = [&]() {
+		size_t start = i;
+		while (i < t.size() && isdigit(t[i])) ++i;
+		return i > start;
+	};
+	if (i < t.size() && t[i] == '-') ++i;
+	if (i < t.size() && t[i] == '0') {
+		++i;
+	} else if (!digits()) {
+		return false;
+	}
+	if (i < t.size() && t[i] == '.') {
+		++i;
+		if (!digits()) return false;
+	}
+	if (i < t.size() && (t[i] == 'e' || t[i] == 'E')) {
+		++i;
+		if (i < t.size() && (t[i] == '+' || t[i] == '-')) ++i;
+		if (!digits()) return false;
+	}
+	return i == t.size();
+}
+
+static std::string json_quote(std::string const &s) {
+	std::ostringstream out;
+	out << '"';
+	for (char c : s) {
+		if (c == '"') out << "\\\"";
+		else if (c == '\\') out << "\\\\";
+		else if (c == '\n') out << "\\n";
+		else if (c == '\t') out << "\\t";
+		else if (uint8_t(c) < 0x20) {
+			out << "\\u00" << "0123456789abcdef"[uint8_t(c) >> 4] << "0123456789abcdef"[uint8_t(c) & 0xf];
+		} else out << c;
+	}
+	out << '"';
+	return out.str();
+}
+
+struct ProblemCache {
+	struct Entry {
+		std::unique_ptr< Problem > problem;
+		CGAL::Polygon_set_2< K > silhouette;
+	};
+	ProblemCache(size_t capacity_) : capacity(capacity_) { }
+	size_t capacity;
+	std::list< std::pair< std::string, Entry > > entries; //most recently used first
+	std::unordered_map< std::string, std::list< std::pair< std::string, Entry > >::iterator > index;
+
+	//returns nullptr (and doesn't cache anything) if load() fails:
+	template< typename LOAD >
+	Entry const *get(std::string const &key, LOAD const &load) {
+		auto f = index.find(key);
+		if (f != index.end()) {
+			entries.splice(entries.begin(), entries, f->second);
+			return &entries.front().second;
+		}
+		std::unique_ptr< Problem > problem = load();
+		if (!problem) return nullptr;
+		entries.emplace_front();
+		entries.front().first = key;
+		entries.front().second.silhouette = problem->get_silhouette();
+		entries.front().second.problem = std::move(problem);
+		index[key] = entries.begin();
+		while (entries.size() > capacity) {
+			index.erase(entries.back().first);
+			entries.pop_back();
+		}
+		return &entries.front().second;
+	}
+};
+
+int serve(size_t cache_size) {
+	ProblemCache cache(cache_size);
+	uint32_t requests = 0;
+	std::string line;
+	while (std::getline(std::cin, line)) {
+		if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+		++requests;
+
+		std::string id = "null";
+		//bad request:
+		auto error = [&id](std::string const &message) {
+			std::cout << "{\"id\":" << id << ",\"error\":" << json_quote(message) << "}" << std::endl;
+		};
+		//bad solution:
+		auto fail = [&id](std::string const &message) {
+			std::cout << "{\"id\":" << id << ",\"valid\":false,\"error\":" << json_quote(message) << "}" << std::endl;
+		};
+
+		std::map< std::string, JsonValue > request;
+		if (!parse_json_object(line, request)) {
+			error("malformed request");
+			continue;
+		}
+		{
+			auto f = request.find("id");
+			if (f != request.end()) {
+				if (f->second.is_string) {
+					id = json_quote(f->second.text);
+				} else if (is_json_literal(f->second.text)) {
+					id = f->second.text;
+				} else {
+					error("'id' must be a string, number, true, false, or null");
+					continue;
+				}
+			}
+		}
+		auto get_string = [&request](std::string const &key, std::string *out) -> bool {
+			auto f = request.find(key);
+			if (f == request.end() || !f->second.is_string) return false;
+			*out = f->second.text;
+			return true;
+		};
+
+		ProblemCache::Entry const *entry = nullptr;
+		std::string text, path;
+		if (get_string("problem_text", &text)) {
+			entry = cache.get("text:" + text, [&text]() {
+				std::istringstream file(text);
+				return Problem::read(file, "<problem_text>");
+			});
+		} else if (get_string("problem", &path)) {
+			entry = cache.get("file:" + path, [&path]() {
+				return Problem::read(path);
+			});
+		} else {
+			error("request needs 'problem' or 'problem_text'");
+			continue;
+		}
+		if (!entry) {
+			error("failed to read problem");
+			continue;
+		}
+
+		std::unique_ptr< Solution > solution;
+		if (get_string("solution_text", &text)) {
+			std::istringstream file(text);
+			solution = Solution::read(file, "<solution_text>");
+		} else if (get_string("solution", &path)) {
+			solution = Solution::read(path);
+		} else {
+			error("request needs 'solution' or 'solution_text'");
+			continue;
+		}
+		if (!solution) {
+			fail("failed to read solution");
+			continue;
+		}
+		if (!solution->is_valid()) {
+			fail("solution isn't valid");
+			continue;
+		}
+
+		auto score = check_solution(entry->silhouette, *solution);
+		std::cout << "{\"id\":" << id << ",\"valid\":true,\"score\":\"" << score << "\",\"approx\":";
+		std::cout << std::fixed << std::setprecision(7) << CGAL::to_double(score) << "}" << std::endl;
+	}
+	std::cerr << "Served " << requests << " requests." << std::endl;
+	return 0;
+}
+
 int main(int argc, char **argv) {
+	if ((argc == 2 || argc == 3) && std::string(argv[1]) == "--serve") {
+		size_t cache_size = 64;
+		if (argc == 3) {
+			cache_size = std::max(1, std::atoi(argv[2]));
+		}
+		return serve(cache_size);
+	}
 	if (argc != 3) {
-		std::cerr << "Usage:\n\t./check <problem> <solution>\n" << std::endl;
+		std::cerr << "Usage:\n\t./check <problem> <solution>\n\t./check --serve [cache-size]  (JSON requests on stdin, one per line)\n" << std::endl;
 		return 1;
 	}
 
@@ -0,0 +1,265 @@
+#include "flat.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+static void load_xf(CGAL::Gmpq const *flat, K::Vector_2 (&out)[3]) {
+	out[0] = K::Vector_2(flat[0], flat[1]);
+	out[1] = K::Vector_2(flat[2], flat[3]);
+	out[2] = K::Vector_2(flat[4], flat[5]);
+}
+
+static void store_xf(K::Vector_2 const (&in)[3], CGAL::Gmpq *flat) {
+	flat[0] = in[0].x(); flat[1] = in[0].y();
+	flat[2] = in[1].x(); flat[3] = in[1].y();
+	flat[4] = in[2].x(); flat[5] = in[2].y();
+}
+
+FlatState::FlatState(State const &state) {
+	for (auto const &facet : state) {
+		push_back(facet);
+	}
+}
+
+void FlatState::push_back(Facet const &facet) {
+	CGAL::Gmpq facet_xf[6];
+	store_xf(facet.xf, facet_xf);
+	begin_facet(facet_xf, facet.flipped);
+	for (auto const &pt : facet.source) {
+		push_corner(pt.x(), pt.y());
+	}
+}
+
+void FlatState::append(FlatState &&other) {
+	uint32_t base = source_x.size();
+	auto move_all = [](std::vector< CGAL::Gmpq > &to, std::vector< CGAL::Gmpq > &from) {
+		to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+	};
+	move_all(source_x, other.source_x);
+	move_all(source_y, other.source_y);
+	move_all(xf, other.xf);
+	for (auto o : other.offset) {
+		offset.emplace_back(base + o);
+	}
+	length.insert(length.end(), other.length.begin(), other.length.end());
+	flipped.insert(flipped.end(), other.flipped.begin(), other.flipped.end());
+	other.clear();
+}
+
+void FlatState::clear() {
+	source_x.clear();
+	source_y.clear();
+	offset.clear();
+	length.clear();
+	xf.clear();
+	flipped.clear();
+}
+
+State FlatState::to_state() const {
+	State state;
+	state.reserve(size());
+	for (uint32_t f = 0; f < size(); ++f) {
+		state.emplace_back();
+		Facet &facet = state.back();
+		for (uint32_t i = offset[f]; i < offset[f] + length[f]; ++i) {
+			facet.source.emplace_back(source_x[i], source_y[i]);
+		}
+		load_xf(&xf[6*f], facet.xf);
+		facet.flipped = flipped[f];
+	}
+	return state;
+}
+
+bool FlatState::fold_dest(K::Point_2 const &a, K::Point_2 const &b) {
+	assert(a != b);
+
+	//everything on the left of a -> b gets flipped:
+	K::Vector_2 flip_xf[3];
+	reflection_xf(a, b, flip_xf);
+
+	//classify / clip once per destination outline (as State::fold_dest does), with destinations
+	// laid out like the sources:
+	std::vector< CGAL::Gmpq > destination_x(source_x.size()), destination_y(source_y.size());
+	parallel_for(size(), [&](uint32_t f) {
+		CGAL::Gmpq const *m = &xf[6*f];
+		for (uint32_t i = offset[f]; i < offset[f] + length[f]; ++i) {
+			destination_x[i] = m[0] * source_x[i] + m[2] * source_y[i] + m[4];
+			destination_y[i] = m[1] * source_x[i] + m[3] * source_y[i] + m[5];
+		}
+	});
+	FoldPlan plan(destination_x, destination_y, offset, length, a, b);
+	destination_x.clear();
+	destination_y.clear();
+
+	//only convex facets are clipped here; non-convex facets crossing the line (possible
+	// when starting from a solution) go through State's polygon set fallback:
+	if (plan.any_fallback) {
+		State state = to_state();
+		bool ret = state.fold_dest(a, b);
+		*this = FlatState(state);
+		return ret;
+	}
+
+	auto fold_facet = [&](uint32_t f, FlatState &result, uint32_t &from_flip, uint32_t &from_noflip) {
+		FoldPlan::Group const &group = plan.group(f);
+		uint32_t begin = offset[f];
+		uint32_t n = length[f];
+		assert(n >= 3);
+
+		if (group.kind == FoldPlan::Group::Keep) {
+			result.begin_facet(&xf[6*f], flipped[f]);
+			for (uint32_t i = begin; i < begin + n; ++i) {
+				result.push_corner(source_x[i], source_y[i]);
+			}
+			++from_noflip;
+			return;
+		}
+
+		CGAL::Gmpq flip_facet_xf[6];
+		{
+			K::Vector_2 facet_xf[3], composed[3];
+			load_xf(&xf[6*f], facet_xf);
+			compose_xf(flip_xf, facet_xf, composed);
+			store_xf(composed, flip_facet_xf);
+		}
+
+		if (group.kind == FoldPlan::Group::Flip) {
+			result.begin_facet(flip_facet_xf, !flipped[f]);
+			for (uint32_t i = begin; i < begin + n; ++i) {
+				result.push_corner(source_x[i], source_y[i]);
+			}
+			++from_flip;
+			return;
+		}
+
+		assert(group.kind == FoldPlan::Group::Clip);
+		//xf is affine, so the parameter along the destination edge works in source too:
+		for (int32_t side : {1, -1}) {
+			if (side > 0) {
+				result.begin_facet(flip_facet_xf, !flipped[f]);
+			} else {
+				result.begin_facet(&xf[6*f], flipped[f]);
+			}
+			for (auto const &c : (side > 0 ? group.flip_corners : group.keep_corners)) {
+				uint32_t i = begin + plan.at(f, c.k);
+				if (!c.crossing) {
+					result.push_corner(source_x[i], source_y[i]);
+					continue;
+				}
+				uint32_t j = begin + plan.at(f, (c.k + 1) % n);
+				result.push_corner(
+					source_x[i] + (source_x[j] - source_x[i]) * c.t,
+					source_y[i] + (source_y[j] - source_y[i]) * c.t
+				);
+			}
+		}
+		++from_flip;
+		++from_noflip;
+	};
+
+	//facets are handled in chunks, each with its own output, which are then concatenated in order
+	// (so the result is the same however the chunks get scheduled):
+	struct Chunk {
+		FlatState pieces;
+		uint32_t from_flip = 0;
+		uint32_t from_noflip = 0;
+	};
+	const uint32_t ChunkSize = 32;
+	std::vector< Chunk > chunks((size() + ChunkSize - 1) / ChunkSize);
+	parallel_for(chunks.size(), [&](uint32_t c) {
+		Chunk &chunk = chunks[c];
+		uint32_t end = std::min< uint32_t >(size(), (c + 1) * ChunkSize);
+		for (uint32_t f = c * ChunkSize; f < end; ++f) {
+			fold_facet(f, chunk.pieces, chunk.from_flip, chunk.from_noflip);
+		}
+	}, 2);
+
+	uint32_t from_flip = 0;
+	uint32_t from_noflip = 0;
+	FlatState result;
+	result.offset.reserve(size());
+	result.length.reserve(size());
+	result.source_x.reserve(source_x.size());
+	result.source_y.reserve(source_y.size());
+	result.xf.reserve(xf.size());
+	result.flipped.reserve(flipped.size());
+	for (auto &chunk : chunks) {
+		result.append(std::move(chunk.pieces));
+		from_flip += chunk.from_flip;
+		from_noflip += chunk.from_noflip;
+	}
+
+	*this = std::move(result);
+
+#ifndef NDEBUG
+	if (from_noflip == 0) {
+		std::cerr << "WARNING: folded *everything*" << std::endl;
+	}
+	if (from_flip == 0) {
+		std::cerr << "WARNING: folded *nothing*" << std::endl;
+	}
+#endif
+	return (from_flip > 0);
+}
+
+void FlatState::print_solution(std::ostream& out) const {
+	auto pp = [](CGAL::Gmpq const &q) -> std::string {
+		std::ostringstream str;
+		str << q.numerator();
+		if (q.denominator() != 1) {
+			str << "/" << q.denominator();
+		}
+		return str.str();
+	};
+
+	//corners sharing a source point are the same vertex:
+	std::unordered_map< K::Point_2, uint32_t, PointHash > vertex_idx;
+	std::vector< uint32_t > corner_vertex(source_x.size());
+	std::vector< K::Point_2 > vertex_destination; //per vertex
+	std::vector< uint32_t > first_corner; //per vertex
+	std::vector< uint32_t > counts; //per vertex
+	for (uint32_t f = 0; f < size(); ++f) {
+		for (uint32_t i = offset[f]; i < offset[f] + length[f]; ++i) {
+			auto ret = vertex_idx.insert(std::make_pair(K::Point_2(source_x[i], source_y[i]), first_corner.size()));
+			if (ret.second) {
+				first_corner.emplace_back(i);
+				vertex_destination.emplace_back(destination(f, i));
+				counts.emplace_back(0);
+			}
+			uint32_t v = ret.first->second;
+			assert(vertex_destination[v] == destination(f, i));
+			corner_vertex[i] = v;
+			counts[v] += 1;
+		}
+	}
+
+	//assign indices by count (as State::print_solution does):
+	std::vector< uint32_t > order(first_corner.size());
+	for (uint32_t v = 0; v < order.size(); ++v) {
+		order[v] = v;
+	}
+	std::stable_sort(order.begin(), order.end(), [&counts](uint32_t a, uint32_t b) {
+		return counts[a] > counts[b];
+	});
+	std::vector< uint32_t > index(order.size());
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		index[order[i]] = i;
+	}
+
+	out << order.size() << "\n";
+	for (auto v : order) {
+		out << pp(source_x[first_corner[v]]) << "," << pp(source_y[first_corner[v]]) << "\n";
+	}
+	out << size() << "\n";
+	for (uint32_t f = 0; f < size(); ++f) {
+		out << length[f];
+		for (uint32_t i = offset[f]; i < offset[f] + length[f]; ++i) {
+			out << " " << index[corner_vertex[i]];
+		}
+		out << "\n";
+	}
+	for (auto v : order) {
+		out << pp(vertex_destination[v].x()) << "," << pp(vertex_destination[v].y()) << "\n";
+	}
+}
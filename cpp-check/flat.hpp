@@ -0,0 +1,54 @@
+#pragma once
+
+#include "utils.hpp"
+#include "folders.hpp"
+
+#include <vector>
+#include <iostream>
+
+//State with all coordinates in flat arrays (structure-of-arrays).
+//Facet i's corners are entries [offset[i], offset[i] + length[i]) of the coordinate arrays,
+// so whole-state sweeps (folding, output) walk memory in order
+// rather than chasing a pair of vectors per facet.
+//As with Facet, only sources are stored; destinations are xf applied to them.
+struct FlatState {
+	std::vector< CGAL::Gmpq > source_x, source_y;
+	std::vector< uint32_t > offset;
+	std::vector< uint32_t > length;
+	//transform from source->destination, six entries per facet (xf[0].x, xf[0].y, xf[1].x, xf[1].y, xf[2].x, xf[2].y):
+	std::vector< CGAL::Gmpq > xf;
+	std::vector< uint8_t > flipped;
+
+	FlatState() = default;
+	explicit FlatState(State const &state);
+	State to_state() const;
+
+	uint32_t size() const { return offset.size(); }
+	void push_back(Facet const &facet);
+	void append(FlatState &&other); //move all of other's facets onto the end
+	void clear();
+
+	//destination of corner i (an index into the coordinate arrays) of facet f:
+	K::Point_2 destination(uint32_t f, uint32_t i) const {
+		CGAL::Gmpq const *m = &xf[6*f];
+		return K::Point_2(m[0] * source_x[i] + m[2] * source_y[i] + m[4], m[1] * source_x[i] + m[3] * source_y[i] + m[5]);
+	}
+
+	//same behavior as State::fold_dest:
+	bool fold_dest(K::Point_2 const &a, K::Point_2 const &b);
+	void print_solution(std::ostream& out) const;
+
+private:
+	//append a corner to the facet currently being built:
+	void push_corner(CGAL::Gmpq const &sx, CGAL::Gmpq const &sy) {
+		source_x.emplace_back(sx);
+		source_y.emplace_back(sy);
+		++length.back();
+	}
+	void begin_facet(CGAL::Gmpq const *facet_xf, bool facet_flipped) {
+		offset.emplace_back(source_x.size());
+		length.emplace_back(0);
+		xf.insert(xf.end(), facet_xf, facet_xf + 6);
+		flipped.emplace_back(facet_flipped);
+	}
+};
@@ -1,12 +1,33 @@
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "structures.hpp"
 #include "folders.hpp"
+#include "parallel.hpp"
+#include "grid.hpp"
+#include "validator.hpp"
 
 //------------- Facet --------------------
 
-void Facet::compute_xf() {
+std::vector< K::Point_2 > Facet::destination() const {
+	std::vector< K::Point_2 > ret;
+	destination(&ret);
+	return ret;
+}
+
+void Facet::destination(std::vector< K::Point_2 > *out) const {
+	out->clear();
+	out->reserve(source.size());
+	for (auto const &pt : source) {
+		out->emplace_back(apply_xf(xf, pt));
+	}
+}
+
+void Facet::compute_xf(std::vector< K::Point_2 > const &destination) {
 	assert(source.size() == destination.size());
 	if (source.size() == 0) {
 		xf[0] = K::Vector_2(1,0);
@@ -68,134 +89,113 @@ void State::unfold() {
 
 bool State::refold(std::vector< K::Point_2 > const &marks) {
 	struct Edge {
-		enum Tag {
+		enum Tag : uint8_t {
 			Outside,
 			Flat,
 			Fold
 		} tag = Outside;
-		K::Point_2 a;
-		K::Point_2 b;
 		uint32_t fa = -1U;
 		uint32_t fb = -1U;
 	};
-	std::vector< Edge > edges;
-	std::unordered_map< std::string, uint32_t > edge_idx;
-	auto add_edge = [&](K::Point_2 const &a, K::Point_2 const &b, uint32_t f) {
-		assert(a.x() < b.x() || (a.x() == b.x() && a.y() <= b.y()));
-		std::ostringstream name;
-		name << a << "," << b;
-		uint32_t idx = edge_idx.insert(std::make_pair(name.str(), edges.size())).first->second;
-		if (idx == edges.size()) {
-			edges.emplace_back();
-			edges.back().a = a;
-			edges.back().b = b;
-			edges.back().fa = f;
-		} else {
-			assert(idx < edges.size());
-			assert(edges[idx].a == a);
-			assert(edges[idx].b == b);
-			assert(edges[idx].tag == Edge::Outside);
-			edges[idx].tag = Edge::Flat;
-			assert(edges[idx].fa != -1U);
-			assert(edges[idx].fb == -1U);
-			edges[idx].fb = f;
-		}
-		assert(edges[idx].fa == f || edges[idx].fb == f);
+
+	//number source vertices, then edges by vertex pair:
+	std::unordered_map< K::Point_2, uint32_t, PointHash > vertex_idx;
+	std::vector< K::Point_2 const * > vertices;
+	auto vertex = [&](K::Point_2 const &pt) {
+		auto ret = vertex_idx.insert(std::make_pair(pt, uint32_t(vertices.size())));
+		if (ret.second) vertices.emplace_back(&ret.first->first);
+		return ret.first->second;
 	};
-	for (auto const &facet : *this) {
+
+	std::vector< Edge > edges;
+	std::vector< std::pair< uint32_t, uint32_t > > edge_verts; //(lexicographically smaller end first)
+	std::unordered_map< uint64_t, uint32_t > edge_idx;
+	//facet f's i'th edge (from source[i] to source[i+1]) is edges[facet_edges[facet_begin[f] + i]]:
+	std::vector< uint32_t > facet_begin;
+	std::vector< uint32_t > facet_edges;
+	facet_begin.reserve(this->size() + 1);
+	facet_begin.emplace_back(0);
+	for (uint32_t f = 0; f < this->size(); ++f) {
+		auto const &facet = (*this)[f];
 		for (uint32_t i = 0; i < facet.source.size(); ++i) {
 			auto const &a = facet.source[i];
 			auto const &b = facet.source[(i+1)%facet.source.size()];
-			if (a.x() < b.x() || (a.x() == b.x() && a.y() <= b.y())) {
-				add_edge(a,b, &facet - &((*this)[0]));
+			uint32_t va = vertex(a);
+			uint32_t vb = vertex(b);
+			if (!(a.x() < b.x() || (a.x() == b.x() && a.y() <= b.y()))) std::swap(va, vb);
+			uint64_t key = (uint64_t(va) << 32) | uint64_t(vb);
+			uint32_t idx = edge_idx.insert(std::make_pair(key, uint32_t(edges.size()))).first->second;
+			if (idx == edges.size()) {
+				edges.emplace_back();
+				edges.back().fa = f;
+				edge_verts.emplace_back(va, vb);
 			} else {
-				add_edge(b,a, &facet - &((*this)[0]));
+				assert(idx < edges.size());
+				assert(edges[idx].tag == Edge::Outside);
+				edges[idx].tag = Edge::Flat;
+				assert(edges[idx].fa != -1U);
+				assert(edges[idx].fb == -1U);
+				edges[idx].fb = f;
 			}
+			assert(edges[idx].fa == f || edges[idx].fb == f);
+			facet_edges.emplace_back(idx);
 		}
+		facet_begin.emplace_back(facet_edges.size());
+	}
+	std::vector< K::Segment_2 > segments;
+	segments.reserve(edges.size());
+	for (auto const &ev : edge_verts) {
+		segments.emplace_back(*vertices[ev.first], *vertices[ev.second]);
 	}
 	//sanity check outside edges:
-	for (auto const &e : edges) {
-		if (e.tag == Edge::Outside) {
+	for (uint32_t e = 0; e < edges.size(); ++e) {
+		if (edges[e].tag == Edge::Outside) {
+			auto const &a = segments[e].source();
+			auto const &b = segments[e].target();
 			assert(
-			       (e.a.x() == 0 && e.b.x() == 0)
-				|| (e.a.x() == 1 && e.b.x() == 1)
-				|| (e.a.y() == 0 && e.b.y() == 0)
-				|| (e.a.y() == 1 && e.b.y() == 1)
+			       (a.x() == 0 && b.x() == 0)
+				|| (a.x() == 1 && b.x() == 1)
+				|| (a.y() == 0 && b.y() == 0)
+				|| (a.y() == 1 && b.y() == 1)
 			);
 		}
-		//std::cerr << "Edge '" << e.a << "," << e.b << "' has " << e.fa << " and " << int32_t(e.fb) << std::endl; //DEBUG
 	}
 
-	auto mark = [&edges](std::vector< K::Point_2 > const &pts, Edge::Tag mark) {
-		for (auto const &pt : pts) {
-			Edge *close = nullptr;
-			CGAL::Gmpq close_len2 = 0;
-			for (auto &e : edges) {
-				K::Line_2 line(e.a, e.b);
-				K::Vector_2 to_line = pt - line.projection(pt);
-				CGAL::Gmpq len2 = to_line * to_line;
-				if (close == nullptr || len2 < close_len2) {
-					close_len2 = len2;
-					close = &e;
-				}
-			}
-			if (!close) {
-				std::cerr << "WARNING: mark at " << pt << " was far from everything." << std::endl;
+	SegmentGrid grid(segments);
+	for (auto const &pt : marks) {
+		uint32_t close = grid.nearest(pt);
+		if (close == -1U) {
+			std::cerr << "WARNING: mark at " << pt << " was far from everything." << std::endl;
+		} else {
+			auto &tag = edges[close].tag;
+			if (tag == Edge::Flat) {
+				tag = Edge::Fold;
+			} else if (tag == Edge::Outside) {
+				std::cerr << "WARNING: mark at " << pt << " trying to mark outside edge." << std::endl;
 			} else {
-				if (close->tag == Edge::Flat) {
-					close->tag = mark;
-				} else if (close->tag == Edge::Outside) {
-					std::cerr << "WARNING: mark at " << pt << " trying to mark outside edge." << std::endl;
-				} else if (close->tag == mark) {
-					std::cerr << "WARNING: mark at " << pt << " is marking an edge twice." << std::endl;
-				} else {
-					std::cerr << "WARNING: mark at " << pt << " is contradicting a different marking." << std::endl;
-				
-				}
+				std::cerr << "WARNING: mark at " << pt << " is marking an edge twice." << std::endl;
 			}
 		}
-	};
-
-	mark(marks, Edge::Fold);
+	}
 
 	//iterate through facets and transform based on folds:
-	std::unordered_set< uint32_t > done;
+	std::vector< uint8_t > done(this->size(), 0);
 	std::vector< uint32_t > to_expand;
 	{
-		(*this)[0].destination = (*this)[0].source;
-		(*this)[0].compute_xf();
-		done.insert(0);
+		(*this)[0].compute_xf((*this)[0].source);
+		done[0] = 1;
 		to_expand.push_back(0);
 	}
 	while (!to_expand.empty()) {
 		uint32_t f_index = to_expand.back();
 		to_expand.pop_back();
-		assert(done.count(f_index));
-		assert(f_index < this->size());
+		assert(done[f_index]);
 		auto &f = (*this)[f_index];
 		//so f's xf is already set, but we should check all the neighbors based on the marks:
 		for (uint32_t i = 0; i < f.source.size(); ++i) {
-			auto const &a = f.source[i];
-			auto const &b = f.source[(i+1)%f.source.size()];
-			std::ostringstream name;
-			if (a.x() < b.x() || (a.x() == b.x() && a.y() <= b.y())) {
-				name << a << "," << b;
-			} else {
-				name << b << "," << a;
-			}
-			//std::cerr << "Facet " << f_index << " found edge " << name.str() << std::endl; //DEBUG
-			auto ii = edge_idx.find(name.str());
-			assert(ii != edge_idx.end());
-			assert(ii->second < edges.size());
-			auto const &edge = edges[ii->second];
-			uint32_t other_index = -1U;
-			if (edge.fa == f_index) {
-				other_index = edge.fb;
-			} else if (edge.fb == f_index) {
-				other_index = edge.fa;
-			} else {
-				assert(0 && "facet must participate in edge");
-			}
+			auto const &edge = edges[facet_edges[facet_begin[f_index] + i]];
+			uint32_t other_index = (edge.fa == f_index ? edge.fb : edge.fa);
+			assert(edge.fa == f_index || edge.fb == f_index);
 			assert(other_index != f_index);
 			if (other_index == -1U) {
 				assert(edge.tag == Edge::Outside);
@@ -204,39 +204,25 @@ bool State::refold(std::vector< K::Point_2 > const &marks) {
 			assert(other_index < this->size());
 
 			K::Vector_2 other_xf[3];
+			bool other_flipped = f.flipped;
 			if (edge.tag == Edge::Flat) {
 				other_xf[0] = f.xf[0];
 				other_xf[1] = f.xf[1];
 				other_xf[2] = f.xf[2];
-			} else if (edge.tag == Edge::Fold) {
-				auto xa = CGAL::ORIGIN + (f.xf[0] * a.x() + f.xf[1] * a.y() + f.xf[2]);
-				auto xb = CGAL::ORIGIN + (f.xf[0] * b.x() + f.xf[1] * b.y() + f.xf[2]);
-				K::Vector_2 along = xb - xa;
-				K::Vector_2 perp(-along.y(), along.x());
-
-				K::Vector_2 flip_xf[3];
-				auto len2 = along * along;
-				flip_xf[0] = K::Vector_2(
-					along.x() * along.x() + -perp.x() * perp.x(),
-					along.y() * along.x() + -perp.y() * perp.x()
-					) / len2;
-				flip_xf[1] = K::Vector_2(
-					along.x() * along.y() + -perp.x() * perp.y(),
-					along.y() * along.y() + -perp.y() * perp.y()
-					) / len2;
-				flip_xf[2] = p2v(xa) - (flip_xf[0] * xa.x() + flip_xf[1] * xa.y());
-
-				other_xf[0] = flip_xf[0] * f.xf[0].x() + flip_xf[1] * f.xf[0].y();
-				other_xf[1] = flip_xf[0] * f.xf[1].x() + flip_xf[1] * f.xf[1].y();
-				other_xf[2] = flip_xf[0] * f.xf[2].x() + flip_xf[1] * f.xf[2].y() + flip_xf[2];
-				assert( other_xf[0] * a.x() + other_xf[1] * a.y() + other_xf[2] == f.xf[0] * a.x() + f.xf[1] * a.y() + f.xf[2] );
-				assert( other_xf[0] * b.x() + other_xf[1] * b.y() + other_xf[2] == f.xf[0] * b.x() + f.xf[1] * b.y() + f.xf[2] );
 			} else {
-				assert(0 && "That should be it in terms of tags.");
+				assert(edge.tag == Edge::Fold);
+				auto const &a = f.source[i];
+				auto const &b = f.source[(i+1)%f.source.size()];
+				K::Vector_2 flip_xf[3];
+				reflection_xf(apply_xf(f.xf, a), apply_xf(f.xf, b), flip_xf);
+				compose_xf(flip_xf, f.xf, other_xf);
+				other_flipped = !other_flipped;
+				assert(apply_xf(other_xf, a) == apply_xf(f.xf, a));
+				assert(apply_xf(other_xf, b) == apply_xf(f.xf, b));
 			}
 
 			auto &other = (*this)[other_index];
-			if (done.count(other_index)) {
+			if (done[other_index]) {
 				if (!( other.xf[0] == other_xf[0]
 					&& other.xf[1] == other_xf[1]
 					&& other.xf[2] == other_xf[2])) {
@@ -248,42 +234,186 @@ bool State::refold(std::vector< K::Point_2 > const &marks) {
 				other.xf[0] = other_xf[0];
 				other.xf[1] = other_xf[1];
 				other.xf[2] = other_xf[2];
-				other.destination.clear();
-				for (auto const &pt : other.source) {
-					other.destination.emplace_back(
-						K::Point_2(0,0) +
-						other.xf[0] * pt.x() + other.xf[1] * pt.y() + other.xf[2]
-					);
-				}
-				done.insert(other_index);
+				other.flipped = other_flipped;
+				done[other_index] = 1;
 				to_expand.push_back(other_index);
 			}
-
-
 		}
 	}
 
-	assert(done.size() == this->size());
+	assert(std::find(done.begin(), done.end(), 0) == done.end());
+	if (validator) validator->moved(*this);
 	return true;
 }
 
-bool State::fold_dest(K::Point_2 const &a, K::Point_2 const &b) {
+//------------- FoldPlan --------------------
+
+FoldPlan::FoldPlan(std::vector< CGAL::Gmpq > const &x, std::vector< CGAL::Gmpq > const &y, std::vector< uint32_t > const &offset, std::vector< uint32_t > const &length, K::Point_2 const &a, K::Point_2 const &b) : polygons(offset.size()) {
 	assert(a != b);
+	assert(x.size() == y.size() && offset.size() == length.size());
+	K::Vector_2 along = b - a;
+	K::Vector_2 perp(-along.y(), along.x());
 
-	K::Line_2 line(a,b);
+	//(sign of the turn at corner j of polygon p, from corner i to corner k)
+	auto turn = [&](uint32_t p, uint32_t i, uint32_t j, uint32_t k) -> int32_t {
+		uint32_t o = offset[p];
+		CGAL::Gmpq cross = (x[o+j] - x[o+i]) * (y[o+k] - y[o+i]) - (y[o+j] - y[o+i]) * (x[o+k] - x[o+i]);
+		return (cross > 0 ? 1 : (cross < 0 ? -1 : 0));
+	};
+
+	//--- group polygons by outline (compared in canonical order) ---
+	std::vector< size_t > hashes(offset.size());
+	parallel_for(offset.size(), [&](uint32_t p) {
+		uint32_t n = length[p];
+		assert(n >= 3);
+		CGAL::Gmpq const *px = &x[offset[p]];
+		CGAL::Gmpq const *py = &y[offset[p]];
+		Polygon &o = polygons[p];
+		o.size = n;
+		for (uint32_t i = 1; i < n; ++i) {
+			if (px[i] < px[o.start] || (px[i] == px[o.start] && py[i] < py[o.start])) {
+				o.start = i;
+			}
+		}
+		//the lexicographically smallest vertex is a convex corner, so its turn gives the orientation:
+		o.reversed = (turn(p, (o.start + n - 1) % n, o.start, (o.start + 1) % n) < 0);
+
+		size_t hash = n;
+		for (uint32_t k = 0; k < n; ++k) {
+			uint32_t i = at(p, k);
+			hash = hash_combine(hash, hash_combine(hash_gmpq(px[i]), hash_gmpq(py[i])));
+		}
+		hashes[p] = hash;
+	});
+
+	std::unordered_multimap< size_t, uint32_t > by_hash;
+	for (uint32_t p = 0; p < offset.size(); ++p) {
+		uint32_t n = length[p];
+		Polygon &o = polygons[p];
+		auto range = by_hash.equal_range(hashes[p]);
+		for (auto gi = range.first; gi != range.second; ++gi) {
+			uint32_t rep = groups[gi->second].rep;
+			if (length[rep] != n) continue;
+			bool same = true;
+			for (uint32_t k = 0; k < n; ++k) {
+				uint32_t i = offset[p] + at(p, k);
+				uint32_t r = offset[rep] + at(rep, k);
+				if (x[i] != x[r] || y[i] != y[r]) {
+					same = false;
+					break;
+				}
+			}
+			if (same) {
+				o.group = gi->second;
+				break;
+			}
+		}
+		if (o.group == -1U) {
+			o.group = groups.size();
+			groups.emplace_back();
+			groups.back().rep = p;
+			by_hash.insert(std::make_pair(hashes[p], o.group));
+		}
+	}
+
+	//--- split each group's outline once ---
+	parallel_for(groups.size(), [&](uint32_t gi) {
+		Group &group = groups[gi];
+		uint32_t p = group.rep;
+		uint32_t n = length[p];
+
+		//signed distance (scaled) of each vertex from the line; positive gets flipped:
+		std::vector< CGAL::Gmpq > amt;
+		amt.reserve(n);
+		for (uint32_t k = 0; k < n; ++k) {
+			uint32_t i = offset[p] + at(p, k);
+			amt.emplace_back(perp.x() * (x[i] - a.x()) + perp.y() * (y[i] - a.y()));
+		}
+
+		LineSide side = line_side(amt.data(), n);
+		if (side == KeepSide) {
+			group.kind = Group::Keep;
+		} else if (side == FlipSide) {
+			group.kind = Group::Flip;
+		} else {
+			//convex if it turns the same way at every (non-collinear) corner:
+			int32_t dir = 0;
+			bool convex = true;
+			for (uint32_t j = 0; j < n && convex; ++j) {
+				int32_t t = turn(p, j, (j + 1) % n, (j + 2) % n);
+				if (t == 0) continue;
+				if (dir == 0) dir = t;
+				if (t != dir) convex = false;
+			}
+			if (convex) {
+				group.kind = Group::Clip;
+				clip_convex(amt.data(), n, &group.flip_corners, &group.keep_corners);
+			} else {
+				group.kind = Group::Fallback;
+			}
+		}
+	});
+	for (auto const &group : groups) {
+		if (group.kind == Group::Fallback) any_fallback = true;
+	}
+}
+
+void State::fold_facets(std::vector< Facet const * > const &facets, K::Point_2 const &a, K::Point_2 const &b, State *pieces, std::vector< uint32_t > *origin, uint32_t *from_flip, uint32_t *from_noflip) {
+	assert(a != b);
 
 	K::Vector_2 along = b - a;
 	K::Vector_2 perp(-along.y(), along.x());
 
-	K::Point_2 min = a;
-	CGAL::Gmpq min_amt = p2v(min) * along;
-	K::Point_2 max = b;
-	CGAL::Gmpq max_amt = p2v(max) * along;
-	K::Point_2 out = a + perp;
-	CGAL::Gmpq out_amt = p2v(out) * perp;
+	//everything on the 'perp' side of the line gets flipped:
+	K::Vector_2 flip_xf[3];
+	reflection_xf(a, b, flip_xf);
+
+	//Facets are classified by which side of the line their vertices are on.
+	//Facets entirely on one side are copied or mirrored as-is; convex facets that
+	// cross the line are clipped exactly. Only non-convex crossing facets (which
+	// can come from a starting solution) fall back to polygon set operations.
+	//
+	//The classification / clipping is done once per destination outline (see FoldPlan).
+	//
+	//Facets only store source and xf; destinations are computed once here and not kept
+	// on the pieces (a mirrored facet is just a new xf).
+
+	//destinations, flat (facet f's corners are [dst_offset[f], dst_offset[f] + dst_length[f])):
+	std::vector< uint32_t > dst_offset(facets.size());
+	std::vector< uint32_t > dst_length(facets.size());
+	uint32_t corners = 0;
+	for (uint32_t f = 0; f < facets.size(); ++f) {
+		dst_offset[f] = corners;
+		dst_length[f] = facets[f]->source.size();
+		corners += dst_length[f];
+	}
+	std::vector< CGAL::Gmpq > dst_x(corners), dst_y(corners);
+	parallel_for(facets.size(), [&](uint32_t f) {
+		for (uint32_t i = 0; i < dst_length[f]; ++i) {
+			K::Point_2 d = facets[f]->destination(i);
+			dst_x[dst_offset[f] + i] = d.x();
+			dst_y[dst_offset[f] + i] = d.y();
+		}
+	});
+	auto dst = [&](uint32_t i) {
+		return K::Point_2(dst_x[i], dst_y[i]);
+	};
+
+	std::unique_ptr< CGAL::Polygon_2< K > > to_fold; //only built if needed by the fallback
+	auto get_to_fold = [&]() -> CGAL::Polygon_2< K > const & {
+		if (to_fold) return *to_fold;
 
-	for (auto const &facet : *this) {
-		for (auto const &pt : facet.destination) {
+		K::Line_2 line(a,b);
+
+		K::Point_2 min = a;
+		CGAL::Gmpq min_amt = p2v(min) * along;
+		K::Point_2 max = b;
+		CGAL::Gmpq max_amt = p2v(max) * along;
+		K::Point_2 out = a + perp;
+		CGAL::Gmpq out_amt = p2v(out) * perp;
+
+		for (uint32_t i = 0; i < corners; ++i) {
+			K::Point_2 pt = dst(i);
 			auto along_amt = along * p2v(pt);
 			if (along_amt < min_amt) {
 				min_amt = along_amt;
@@ -299,67 +429,128 @@ bool State::fold_dest(K::Point_2 const &a, K::Point_2 const &b) {
 				out = pt;
 			}
 		}
-	}
 
-	CGAL::Polygon_2< K > to_fold;
+		min = min - along;
+		max = max + along;
+		out = out + perp;
 
-	min = min - along;
-	max = max + along;
-	out = out + perp;
+		auto to_out = out - line.projection(out);
 
-	auto to_out = out - line.projection(out);
+		to_fold.reset(new CGAL::Polygon_2< K >());
+		to_fold->push_back(line.projection(min));
+		to_fold->push_back(line.projection(max));
+		to_fold->push_back(line.projection(max) + to_out);
+		to_fold->push_back(line.projection(min) + to_out);
 
-	to_fold.push_back(line.projection(min));
-	to_fold.push_back(line.projection(max));
-	to_fold.push_back(line.projection(max) + to_out);
-	to_fold.push_back(line.projection(min) + to_out);
+		assert(to_fold->orientation() == CGAL::COUNTERCLOCKWISE);
+		return *to_fold;
+	};
 
-	assert(to_fold.orientation() == CGAL::COUNTERCLOCKWISE);
+	auto flipped_xf = [&flip_xf](Facet const &facet, Facet &f) {
+		compose_xf(flip_xf, facet.xf, f.xf);
+		f.flipped = !facet.flipped;
+	};
 
-	K::Vector_2 flip_xf[3];
-	{
-		auto len2 = along * along;
-		flip_xf[0] = K::Vector_2(
-			along.x() * along.x() + -perp.x() * perp.x(),
-			along.y() * along.x() + -perp.y() * perp.x()
-			) / len2;
-		flip_xf[1] = K::Vector_2(
-			along.x() * along.y() + -perp.x() * perp.y(),
-			along.y() * along.y() + -perp.y() * perp.y()
-			) / len2;
-		flip_xf[2] = p2v(a) - (flip_xf[0] * a.x() + flip_xf[1] * a.y());
+	FoldPlan plan(dst_x, dst_y, dst_offset, dst_length, a, b);
 
-		assert(flip_xf[0] * (b + perp).x() + flip_xf[1] * (b + perp).y() + flip_xf[2] == p2v(b - perp));
+	//--- fan results out to every facet (in the original order) ---
+	if (plan.any_fallback) {
+		get_to_fold(); //build it now, rather than racing to build it during the fan-out
 	}
 
-	uint32_t from_flip = 0;
-	uint32_t from_noflip = 0;
+	auto fold_facet = [&](uint32_t fi, State &result, uint32_t &from_flip, uint32_t &from_noflip) {
+		Facet const &facet = *facets[fi];
+		FoldPlan::Group const &group = plan.group(fi);
+		uint32_t n = facet.source.size();
 
-	//any facet whose destination overlaps the line through a and b gets split.
-	State result;
-	for (auto const &facet : *this) {
-		CGAL::Polygon_2< K > p(facet.destination.begin(), facet.destination.end());
+		if (group.kind == FoldPlan::Group::Keep) {
+			result.emplace_back(facet);
+			++from_noflip;
+			return;
+		}
+
+		if (group.kind == FoldPlan::Group::Flip) {
+			result.emplace_back();
+			Facet &f = result.back();
+			flipped_xf(facet, f);
+			f.source.reserve(n);
+			for (uint32_t k = 0; k < n; ++k) {
+				f.source.emplace_back(facet.source[plan.at(fi, k)]);
+			}
+			++from_flip;
+			return;
+		}
+
+		if (group.kind == FoldPlan::Group::Clip) {
+			//xf is affine, so the same parameter works in source and destination:
+			auto corner_source = [&](ClipCorner const &c) -> K::Point_2 {
+				K::Point_2 const &s = facet.source[plan.at(fi, c.k)];
+				if (!c.crossing) return s;
+				return s + (facet.source[plan.at(fi, (c.k + 1) % n)] - s) * c.t;
+			};
+
+			result.emplace_back();
+			{
+				Facet &flip = result.back();
+				flipped_xf(facet, flip);
+				flip.source.reserve(group.flip_corners.size());
+				for (auto const &c : group.flip_corners) {
+					flip.source.emplace_back(corner_source(c));
+				}
+				//paranoia:
+				for (uint32_t i = 0; i < flip.source.size(); ++i) {
+					assert(perp * (flip.destination(i) - a) <= 0);
+				}
+			}
+			++from_flip;
+
+			result.emplace_back();
+			{
+				Facet &keep = result.back();
+				keep.xf[0] = facet.xf[0];
+				keep.xf[1] = facet.xf[1];
+				keep.xf[2] = facet.xf[2];
+				keep.flipped = facet.flipped;
+				keep.source.reserve(group.keep_corners.size());
+				for (auto const &c : group.keep_corners) {
+					keep.source.emplace_back(corner_source(c));
+				}
+				//paranoia:
+				for (uint32_t i = 0; i < keep.source.size(); ++i) {
+					assert(perp * (keep.destination(i) - a) <= 0);
+				}
+			}
+			++from_noflip;
+			return;
+		}
+
+		assert(group.kind == FoldPlan::Group::Fallback);
+		//non-convex facet crossing the line; use polygon set operations:
+		CGAL::Polygon_2< K > p;
+		for (uint32_t i = dst_offset[fi]; i < dst_offset[fi] + dst_length[fi]; ++i) {
+			p.push_back(dst(i));
+		}
 		if (p.orientation() != CGAL::COUNTERCLOCKWISE) {
 			p.reverse_orientation();
 		}
 
-		auto set_source_from_dest = [](Facet &f) {
-			for (auto const &v : f.destination) {
+		auto set_source_from_dest = [](Facet &f, std::vector< K::Point_2 > const &dst) {
+			for (auto const &v : dst) {
 				f.source.emplace_back(
 					K::Point_2(0,0)
 					+ K::Vector_2(f.xf[0].x(), f.xf[1].x()) * (v - f.xf[2]).x()
 					+ K::Vector_2(f.xf[0].y(), f.xf[1].y()) * (v - f.xf[2]).y()
 				);
 			}
-			assert(f.source.size() == f.destination.size());
+			assert(f.source.size() == dst.size());
 			for (uint32_t i = 0; i < f.source.size(); ++i) {
-				assert(f.xf[0] * f.source[i].x() + f.xf[1] * f.source[i].y() + f.xf[2] == p2v(f.destination[i]));
+				assert(f.destination(i) == dst[i]);
 			}
 		};
 
 		CGAL::Polygon_set_2< K > flip;
 		flip.join(p);
-		flip.intersection(to_fold);
+		flip.intersection(get_to_fold());
 		{ //read back the flipped parts:
 			std::list< CGAL::Polygon_with_holes_2< K > > res;
 			flip.polygons_with_holes( std::back_inserter( res ) );
@@ -368,18 +559,12 @@ bool State::fold_dest(K::Point_2 const &a, K::Point_2 const &b) {
 				assert(poly.holes_begin() == poly.holes_end()); //no holes in facet
 				auto boundary = poly.outer_boundary();
 				Facet f;
-				f.xf[0] = flip_xf[0] * facet.xf[0].x() + flip_xf[1] * facet.xf[0].y();
-				f.xf[1] = flip_xf[0] * facet.xf[1].x() + flip_xf[1] * facet.xf[1].y();
-				f.xf[2] = flip_xf[0] * facet.xf[2].x() + flip_xf[1] * facet.xf[2].y() + flip_xf[2];
-				f.flipped = !facet.flipped;
+				flipped_xf(facet, f);
+				std::vector< K::Point_2 > dst;
 				for (auto vi = boundary.vertices_begin(); vi != boundary.vertices_end(); ++vi) {
-					K::Point_2 v = *vi;
-					K::Point_2 flipped = line.projection(v) + (line.projection(v) - v); //flip over the line
-					v = K::Point_2(0,0) + flip_xf[0] * v.x() + flip_xf[1] * v.y() + flip_xf[2]; //line.projection(v) + (line.projection(v) - v); //flip over the line
-					assert(v == flipped);
-					f.destination.emplace_back(v);
+					dst.emplace_back(apply_xf(flip_xf, *vi));
 				}
-				set_source_from_dest(f);
+				set_source_from_dest(f, dst);
 				result.emplace_back(f);
 				++from_flip;
 			}
@@ -387,7 +572,7 @@ bool State::fold_dest(K::Point_2 const &a, K::Point_2 const &b) {
 
 		CGAL::Polygon_set_2< K > noflip;
 		noflip.join(p);
-		noflip.difference(to_fold);
+		noflip.difference(get_to_fold());
 		{ //read back the not-flipped parts:
 			std::list< CGAL::Polygon_with_holes_2< K > > res;
 			noflip.polygons_with_holes( std::back_inserter( res ) );
@@ -400,17 +585,58 @@ bool State::fold_dest(K::Point_2 const &a, K::Point_2 const &b) {
 				f.xf[1] = facet.xf[1];
 				f.xf[2] = facet.xf[2];
 				f.flipped = facet.flipped;
-				for (auto vi = boundary.vertices_begin(); vi != boundary.vertices_end(); ++vi) {
-					K::Point_2 v = *vi;
-					f.destination.emplace_back(v);
-				}
-				set_source_from_dest(f);
+				std::vector< K::Point_2 > dst(boundary.vertices_begin(), boundary.vertices_end());
+				set_source_from_dest(f, dst);
 				result.emplace_back(f);
 				++from_noflip;
 			}
 		}
+	};
+
+	//facets are handled in chunks, each with its own output, which are then concatenated in order
+	// (so the result is the same however the chunks get scheduled):
+	struct Chunk {
+		State pieces;
+		std::vector< uint32_t > origin;
+		uint32_t from_flip = 0;
+		uint32_t from_noflip = 0;
+	};
+	const uint32_t ChunkSize = 32;
+	std::vector< Chunk > chunks((facets.size() + ChunkSize - 1) / ChunkSize);
+	parallel_for(chunks.size(), [&](uint32_t c) {
+		Chunk &chunk = chunks[c];
+		uint32_t end = std::min< uint32_t >(facets.size(), (c + 1) * ChunkSize);
+		for (uint32_t fi = c * ChunkSize; fi < end; ++fi) {
+			fold_facet(fi, chunk.pieces, chunk.from_flip, chunk.from_noflip);
+			if (origin) chunk.origin.resize(chunk.pieces.size(), fi);
+		}
+	}, 2);
+
+	*from_flip = 0;
+	*from_noflip = 0;
+	for (auto &chunk : chunks) {
+		pieces->insert(pieces->end(), std::make_move_iterator(chunk.pieces.begin()), std::make_move_iterator(chunk.pieces.end()));
+		if (origin) origin->insert(origin->end(), chunk.origin.begin(), chunk.origin.end());
+		*from_flip += chunk.from_flip;
+		*from_noflip += chunk.from_noflip;
+	}
+}
+
+bool State::fold_dest(K::Point_2 const &a, K::Point_2 const &b) {
+	std::vector< Facet const * > facets;
+	facets.reserve(this->size());
+	for (auto const &facet : *this) {
+		facets.emplace_back(&facet);
 	}
-	*this = result;
+
+	State result;
+	result.reserve(this->size());
+	std::vector< uint32_t > origin;
+	uint32_t from_flip = 0;
+	uint32_t from_noflip = 0;
+	fold_facets(facets, a, b, &result, (validator ? &origin : nullptr), &from_flip, &from_noflip);
+	this->swap(result); //(keeps the old facets alive in 'result' for the validator)
+	if (validator) validator->fold(facets, *this, origin);
 
 #ifndef NDEBUG
 	if (from_noflip == 0) {
@@ -460,12 +686,13 @@ void State::print_solution(std::ostream& out) const {
 	std::vector< std::string > source_verts(source_inds.size());
 	std::vector< std::string > destination_verts(source_inds.size());
 	std::ostringstream facet_info;
+	std::vector< K::Point_2 > destination;
 	for (auto const &facet : *this) {
-		assert(facet.source.size() == facet.destination.size());
+		facet.destination(&destination);
 		facet_info << facet.source.size();
 		for (uint_fast32_t i = 0; i < facet.source.size(); ++i) {
 			std::string src_name = pp(facet.source[i].x()) + "," + pp(facet.source[i].y());
-			std::string dst_name = pp(facet.destination[i].x()) + "," + pp(facet.destination[i].y());
+			std::string dst_name = pp(destination[i].x()) + "," + pp(destination[i].y());
 			uint32_t idx = source_inds.insert(std::make_pair(src_name, source_inds.size())).first->second;
 			assert(idx < source_verts.size());
 			assert(source_verts[idx] == "" || source_verts[idx] == src_name);
@@ -490,65 +717,43 @@ void State::print_solution(std::ostream& out) const {
 	}
 }
 
-State State::normalized() const {
-	State solution = *this;
+//number of characters in the decimal form of n:
+static uint32_t decimal_length(uint64_t n) {
+	uint32_t len = 1;
+	while (n >= 10) {
+		n /= 10;
+		++len;
+	}
+	return len;
+}
 
-	//helper:
-	auto merge = [](Facet const &f1, uint32_t e1, Facet const &f2, uint32_t e2) -> Facet {
-		Facet merged;
-		assert(f1.xf[0] == f2.xf[0]);
-		assert(f1.xf[1] == f2.xf[1]);
-		assert(f1.xf[2] == f2.xf[2]);
-		assert(f1.flipped == f2.flipped);
-		merged.xf[0] = f1.xf[0];
-		merged.xf[1] = f1.xf[1];
-		merged.xf[2] = f1.xf[2];
-		merged.flipped = f1.flipped;
-		merged.source.reserve(f1.source.size() + f2.source.size());
-
-		uint32_t c1 = (e1 + 1) % f1.source.size();
-		while (c1 != e1) {
-			merged.source.emplace_back(f1.source[c1]);
-			c1 = (c1+1) % f1.source.size();
-		}
-
-		uint32_t c2 = (e2 + 1) % f2.source.size();
-		while (c2 != e2) {
-			merged.source.emplace_back(f2.source[c2]);
-			c2 = (c2+1) % f2.source.size();
-		}
-
-		//now de-duplicate anything that looks like [..., a, b, a, ...]
-
-
-		bool removed = true;
-		while (removed) {
-			removed = false;
-			uint32_t s = 0;
-			while (s < merged.source.size()) {
-				assert(merged.source.size() >= 3);
-				auto const &a = merged.source[s];
-				//auto const &b = merged.source[(s+1)%merged.source.size()];
-				auto const &c = merged.source[(s+2)%merged.source.size()];
-				if (a == c) {
-					uint32_t i1 = (s+1)%merged.source.size();
-					uint32_t i2 = (s+2)%merged.source.size();
-					if (i2 < i1) std::swap(i1, i2);
-					assert(i1 < i2);
-					merged.source.erase(merged.source.begin() + i2);
-					if (i2 < s) s -= 1;
-					merged.source.erase(merged.source.begin() + i1);
-					if (i1 < s) s -= 1;
-					assert(s < merged.source.size());
-					removed = true;
-				} else {
-					//go to next pattern:
-					++s;
-				}
-			}
-		}
-		return merged;
-	};
+static uint32_t decimal_length(mpz_srcptr z) {
+	uint32_t sign = (mpz_sgn(z) < 0 ? 1 : 0);
+	if (mpz_fits_slong_p(z)) {
+		long v = mpz_get_si(z);
+		return sign + decimal_length(uint64_t(v < 0 ? -(v + 1) + 1ULL : v));
+	}
+	//mpz_sizeinbase may be one too large; check against 10^(len-1):
+	uint32_t len = mpz_sizeinbase(z, 10);
+	mpz_t bound;
+	mpz_init(bound);
+	mpz_ui_pow_ui(bound, 10, len - 1);
+	if (mpz_cmpabs(z, bound) < 0) --len;
+	mpz_clear(bound);
+	return sign + len;
+}
+
+//length of q as print_solution writes it ("num" or "num/den"):
+static uint32_t printed_length(CGAL::Gmpq const &q) {
+	uint32_t len = decimal_length(mpq_numref(q.mpq()));
+	if (mpz_cmp_ui(mpq_denref(q.mpq()), 1) != 0) {
+		len += 1 + decimal_length(mpq_denref(q.mpq()));
+	}
+	return len;
+}
+
+State State::normalized(bool verbose) const {
+	State solution = *this;
 
 	//make all facets ccw:
 	uint32_t flipped = 0;
@@ -557,145 +762,243 @@ State State::normalized() const {
 		if (poly.orientation() != CGAL::COUNTERCLOCKWISE) {
 			++flipped;
 			std::reverse(f.source.begin(), f.source.end());
-			std::reverse(f.destination.begin(), f.destination.end());
 		}
 	}
-	std::cerr << "Flipped " << flipped << " CW facets." << std::endl;
+	if (verbose) std::cerr << "Flipped " << flipped << " CW facets." << std::endl;
 
 	//now merge adjacent facets with the same xf:
-	uint32_t merges = 0;
-	//(iterative quadratic all-pairs way; could use hash to make faster)
-	bool progress = true;
-	while (progress) {
-		progress = false;
-
-		for (auto const &f1 : solution) {
-			for (auto const &f2 : solution) {
-				if (&f2 >= &f1) break; //avoid doing pairs twice
-				if (f1.xf[0] != f2.xf[0]) continue; //different xform
-				if (f1.xf[1] != f2.xf[1]) continue;
-				if (f1.xf[2] != f2.xf[2]) continue;
-				//check for adjacent edge:
-				for (uint32_t e1 = 0; e1 < f1.source.size(); ++e1) {
-					auto const &a1 = f1.source[e1];
-					auto const &b1 = f1.source[(e1+1)%f1.source.size()];
-					for (uint32_t e2 = 0; e2 < f2.source.size(); ++e2) {
-						auto const &a2 = f2.source[e2];
-						auto const &b2 = f2.source[(e2+1)%f2.source.size()];
-
-						if (a1 == a2 && b1 == b2) {
-							assert(0 && "ERROR: same edge in same order in two facets.");
-						}
-						if (!(a1 == b2 && b1 == a2)) continue;
-
-						++merges;
-
-						//okay, have an edge to merge along
-						Facet new_facet = merge(f1, e1, f2, e2);
-
-						uint32_t i1 = &f1 - &solution[0];
-						uint32_t i2 = &f2 - &solution[0];
-						assert(i2 < i1);
-						solution.erase(solution.begin() + i1);
-						solution.erase(solution.begin() + i2);
-						solution.emplace_back(new_facet);
-
-						progress = true;
-						break;
-					}
-					if (progress) break;
-				}
-				if (progress) break;
-			}
-			if (progress) break;
+	//directed source edges are indexed by endpoints, so each edge finds its twin (the reversed edge
+	// of the neighbouring facet) by lookup; facets joined by a twin with the same xf are unioned:
+	struct EdgeHash {
+		size_t operator()(std::pair< K::Point_2, K::Point_2 > const &e) const {
+			return hash_combine(PointHash()(e.first), PointHash()(e.second));
+		}
+	};
+	std::unordered_map< std::pair< K::Point_2, K::Point_2 >, uint32_t, EdgeHash > edge_facet;
+	for (uint32_t f = 0; f < solution.size(); ++f) {
+		auto const &src = solution[f].source;
+		for (uint32_t i = 0; i < src.size(); ++i) {
+			bool inserted = edge_facet.insert(std::make_pair(std::make_pair(src[i], src[(i+1)%src.size()]), f)).second;
+			assert(inserted && "ERROR: same edge in same order in two facets.");
+			(void)inserted;
 		}
 	}
 
-	//now that facets are merged, get rid of colinear verts in each facet:
-	for (auto &f : solution) {
-		bool removed = true;
-		while (removed) {
-			removed = false;
-			uint32_t s = 0;
-			while (s < f.source.size()) {
-				assert(f.source.size() >= 3);
-				auto const &a = f.source[s];
-				auto const &b = f.source[(s+1)%f.source.size()];
-				auto const &c = f.source[(s+2)%f.source.size()];
-				if (K::Line_2(a,c).projection(b) == b) {
-					uint32_t i = (s+1)%f.source.size();
-					f.source.erase(f.source.begin() + i);
-					if (i < s) s -= 1;
-					assert(s < f.source.size());
-					removed = true;
-				} else {
-					//go to next pattern:
-					++s;
-				}
+	std::vector< uint32_t > parent(solution.size());
+	for (uint32_t f = 0; f < solution.size(); ++f) {
+		parent[f] = f;
+	}
+	auto find = [&parent](uint32_t f) {
+		while (parent[f] != f) {
+			parent[f] = parent[parent[f]];
+			f = parent[f];
+		}
+		return f;
+	};
+	auto same_xf = [](Facet const &f1, Facet const &f2) {
+		return f1.xf[0] == f2.xf[0] && f1.xf[1] == f2.xf[1] && f1.xf[2] == f2.xf[2];
+	};
+	for (uint32_t f = 0; f < solution.size(); ++f) {
+		auto const &src = solution[f].source;
+		for (uint32_t i = 0; i < src.size(); ++i) {
+			auto twin = edge_facet.find(std::make_pair(src[(i+1)%src.size()], src[i]));
+			if (twin == edge_facet.end() || twin->second >= f) continue; //(each pair once)
+			if (!same_xf(solution[f], solution[twin->second])) continue;
+			uint32_t a = find(f);
+			uint32_t b = find(twin->second);
+			if (a != b) parent[std::max(a, b)] = std::min(a, b);
+		}
+	}
+
+	//each group's outline is the edges without a twin in the group, chained end to start:
+	std::vector< std::vector< uint32_t > > members(solution.size());
+	for (uint32_t f = 0; f < solution.size(); ++f) {
+		members[find(f)].emplace_back(f);
+	}
+	State merged;
+	merged.reserve(solution.size());
+	uint32_t merges = 0;
+	for (uint32_t root = 0; root < solution.size(); ++root) {
+		auto const &group = members[root];
+		if (group.empty()) continue;
+		if (group.size() == 1) {
+			merged.emplace_back(std::move(solution[root]));
+			continue;
+		}
+
+		std::unordered_map< K::Point_2, K::Point_2, PointHash > next; //outline edge start -> end
+		K::Point_2 const *first = nullptr;
+		bool simple = true;
+		for (uint32_t f : group) {
+			auto const &src = solution[f].source;
+			for (uint32_t i = 0; i < src.size(); ++i) {
+				auto const &a = src[i];
+				auto const &b = src[(i+1)%src.size()];
+				auto twin = edge_facet.find(std::make_pair(b, a));
+				if (twin != edge_facet.end() && find(twin->second) == root) continue;
+				if (!next.insert(std::make_pair(a, b)).second) simple = false; //outline touches itself
+				if (!first) first = &a;
 			}
 		}
+		std::vector< K::Point_2 > outline;
+		if (simple && first) {
+			K::Point_2 at = *first;
+			do {
+				outline.emplace_back(at);
+				auto n = next.find(at);
+				if (n == next.end() || outline.size() > next.size()) break;
+				at = n->second;
+			} while (at != *first);
+			//(a group with a hole has more outline edges than its outer loop)
+			simple = (at == *first && outline.size() == next.size());
+		}
+		if (!simple) {
+			//not a simple polygon once merged; leave the group as it was:
+			for (uint32_t f : group) {
+				merged.emplace_back(std::move(solution[f]));
+			}
+			continue;
+		}
 
+		merges += group.size() - 1;
+		merged.emplace_back();
+		Facet &facet = merged.back();
+		facet.xf[0] = solution[root].xf[0];
+		facet.xf[1] = solution[root].xf[1];
+		facet.xf[2] = solution[root].xf[2];
+		facet.flipped = solution[root].flipped;
+		facet.source = std::move(outline);
 	}
+	solution.swap(merged);
+	if (verbose) std::cerr << "Merged away " << merges << " facets." << std::endl;
 
-	
-	//fix up destinations again:
+	//now that facets are merged, get rid of colinear verts in each facet (one pass, using the output as a stack):
 	for (auto &f : solution) {
-		f.destination.clear();
-		f.destination.reserve(f.source.size());
-		for (auto const &s : f.source) {
-			f.destination.emplace_back( CGAL::ORIGIN + f.xf[0] * s.x() + f.xf[1] * s.y() + f.xf[2] );
+		std::vector< K::Point_2 > kept;
+		kept.reserve(f.source.size());
+		for (auto const &pt : f.source) {
+			while (kept.size() >= 2 && CGAL::collinear(kept[kept.size()-2], kept.back(), pt)) {
+				kept.pop_back();
+			}
+			kept.emplace_back(pt);
+		}
+		//...and around the wrap:
+		uint32_t begin = 0;
+		while (kept.size() - begin >= 3) {
+			if (CGAL::collinear(kept[kept.size()-2], kept.back(), kept[begin])) {
+				kept.pop_back();
+			} else if (CGAL::collinear(kept.back(), kept[begin], kept[begin+1])) {
+				++begin;
+			} else {
+				break;
+			}
 		}
+		assert(kept.size() - begin >= 3);
+		f.source.assign(kept.begin() + begin, kept.end());
 	}
 
+
 	//---------- find best (8-way) orientation ----------
 
-	auto refl = [&solution](){
-		for (auto &facet : solution) {
-			for (auto &pt : facet.source) {
-				pt = K::Point_2(1 - pt.x(), pt.y());
-			}
-			facet.compute_xf();
-		}
-	};
-	auto rot90 = [&solution](){
-		for (auto &facet : solution) {
-			for (auto &pt : facet.source) {
-				pt = K::Point_2(1 - pt.y(), pt.x());
+	//print_solution's output size (in graphic characters) is counted from digit lengths rather than by printing.
+	//Only the source coordinates change between orientations (each becomes one of x, 1-x, y, 1-y);
+	// vertex and facet counts, destinations, and the index digits (indices go by use count) all stay put.
+
+	std::unordered_map< K::Point_2, uint32_t, PointHash > vertex_ind;
+	std::vector< K::Point_2 const * > vertex_pt; //(first use of each vertex)
+	std::vector< std::pair< uint32_t, uint32_t > > vertex_use; //facet, corner of first use
+	std::vector< uint32_t > vertex_count;
+	for (auto const &facet : solution) {
+		for (uint32_t i = 0; i < facet.source.size(); ++i) {
+			auto res = vertex_ind.insert(std::make_pair(facet.source[i], uint32_t(vertex_pt.size())));
+			if (res.second) {
+				vertex_pt.emplace_back(&facet.source[i]);
+				vertex_use.emplace_back(&facet - &solution[0], i);
+				vertex_count.emplace_back(0);
 			}
-			facet.compute_xf();
+			vertex_count[res.first->second] += 1;
 		}
-	};
+	}
 
-	
-	State best = solution;
-	uint32_t best_count = 999999;
-	auto test = [&solution, &best, &best_count]() {
-		std::ostringstream out;
-		solution.print_solution(out);
+	//length of each vertex's candidate source coordinates (x, 1-x, y, 1-y) and of its destination name:
+	std::vector< std::array< uint32_t, 4 > > coord_length(vertex_pt.size());
+	std::vector< uint64_t > destination_length(vertex_pt.size());
+	parallel_for(vertex_pt.size(), [&](uint32_t v) {
+		K::Point_2 const &pt = *vertex_pt[v];
+		coord_length[v][0] = printed_length(pt.x());
+		coord_length[v][1] = printed_length(1 - pt.x());
+		coord_length[v][2] = printed_length(pt.y());
+		coord_length[v][3] = printed_length(1 - pt.y());
+		K::Point_2 dst = solution[vertex_use[v].first].destination(vertex_use[v].second);
+		destination_length[v] = printed_length(dst.x()) + 1 + printed_length(dst.y());
+	});
+
+	uint64_t fixed_count = decimal_length(vertex_pt.size()) + decimal_length(solution.size());
+	for (auto const &facet : solution) {
+		fixed_count += decimal_length(facet.source.size());
+	}
+	{ //index digits: the vertex used most gets index 0, and so on (ties don't change the total):
+		std::vector< uint32_t > counts(vertex_count);
+		std::sort(counts.begin(), counts.end(), std::greater< uint32_t >());
+		for (uint32_t i = 0; i < counts.size(); ++i) {
+			fixed_count += uint64_t(counts[i]) * decimal_length(i);
+		}
+	}
+	for (auto l : destination_length) {
+		fixed_count += l;
+	}
 
-		//std::cerr << out.str(); //DEBUG
+	//orientations in the order they were always tried (three turns, a reflection, four more turns),
+	// as which of x, 1-x, y, 1-y (0-3) each source coordinate becomes:
+	std::vector< std::pair< uint8_t, uint8_t > > orientations;
+	{
+		auto flip = [](uint8_t c) -> uint8_t { return c ^ 1; }; //x <-> 1-x, y <-> 1-y
+		std::pair< uint8_t, uint8_t > at(0, 2);
+		auto rot90 = [&]() { at = std::make_pair(flip(at.second), at.first); }; //(x,y) -> (1-y,x)
+		auto refl = [&]() { at.first = flip(at.first); }; //(x,y) -> (1-x,y)
+		orientations.emplace_back(at);
+		rot90(); orientations.emplace_back(at);
+		rot90(); orientations.emplace_back(at);
+		rot90(); orientations.emplace_back(at);
+		refl();
+		rot90(); orientations.emplace_back(at);
+		rot90(); orientations.emplace_back(at);
+		rot90(); orientations.emplace_back(at);
+		rot90(); orientations.emplace_back(at);
+	}
 
-		std::string str = out.str();
-		uint32_t count = 0;
-		for (char c : str) {
-			if (isgraph(c)) ++count;
-		}
-		std::cerr << "Count is " << count << std::endl;
-		if (count < best_count) {
-			best_count = count;
-			best = solution;
+	std::vector< uint64_t > counts(orientations.size(), fixed_count);
+	parallel_for(orientations.size(), [&](uint32_t o) {
+		auto const &orient = orientations[o];
+		for (auto const &l : coord_length) {
+			counts[o] += l[orient.first] + 1 + l[orient.second];
 		}
-	};
+	}, 1);
+
+	uint32_t best = 0;
+	for (uint32_t o = 0; o < counts.size(); ++o) {
+		if (verbose) std::cerr << "Count is " << counts[o] << std::endl;
+		if (counts[o] < counts[best]) best = o;
+	}
+
+	//only the winner gets transformed:
+	if (best != 0) {
+		auto const &orient = orientations[best];
+		auto coord = [](K::Point_2 const &pt, uint8_t c) -> CGAL::Gmpq {
+			if (c == 0) return pt.x();
+			else if (c == 1) return 1 - pt.x();
+			else if (c == 2) return pt.y();
+			else return 1 - pt.y();
+		};
+		parallel_for(solution.size(), [&](uint32_t f) {
+			Facet &facet = solution[f];
+			auto destination = facet.destination();
+			for (auto &pt : facet.source) {
+				pt = K::Point_2(coord(pt, orient.first), coord(pt, orient.second));
+			}
+			facet.compute_xf(destination);
+		});
+	}
 
-	test();
-	rot90(); test();
-	rot90(); test();
-	rot90(); test();
-	refl();
-	rot90(); test();
-	rot90(); test();
-	rot90(); test();
-	rot90(); test();
-
-	return best;
+	return solution;
 }
@@ -2,11 +2,11 @@
 
 #include "utils.hpp"
 #include "structures.hpp"
+#include <memory>
 #include <vector>
 
 struct Facet {
 	std::vector< K::Point_2 > source;
-	std::vector< K::Point_2 > destination;
 
 	//transform from source->destination as 2x3 (column major) matrix:
 	K::Vector_2 xf[3] = {
@@ -17,12 +17,78 @@ struct Facet {
 	//for convenience (can be computed from xf):
 	bool flipped = false;
 
-	void compute_xf();
+	//destination positions are xf applied to source, computed on demand:
+	K::Point_2 destination(uint32_t i) const {
+		return apply_xf(xf, source[i]);
+	}
+	std::vector< K::Point_2 > destination() const;
+	//(same, into a reused buffer, for loops over many facets)
+	void destination(std::vector< K::Point_2 > *out) const;
+
+	//set xf (and flipped) to carry source onto destination (one position per source vertex):
+	void compute_xf(std::vector< K::Point_2 > const &destination);
+};
+
+//How a list of polygons (facet destination outlines) splits over the fold line a -> b
+// (everything left of a -> b gets flipped).
+//After a few folds many facets are stacked on exactly the same outline, so polygons are grouped
+// by outline and each group is classified / clipped once:
+struct FoldPlan {
+	//polygon p's corners are entries [offset[p], offset[p] + length[p]) of x and y:
+	FoldPlan(std::vector< CGAL::Gmpq > const &x, std::vector< CGAL::Gmpq > const &y, std::vector< uint32_t > const &offset, std::vector< uint32_t > const &length, K::Point_2 const &a, K::Point_2 const &b);
+
+	struct Group {
+		uint32_t rep; //first polygon with this outline
+		enum Kind {
+			Keep,
+			Flip,
+			Clip,
+			Fallback //crosses the line but isn't convex
+		} kind = Keep;
+		std::vector< ClipCorner > flip_corners, keep_corners; //(Clip) pieces, in canonical corner order
+	};
+	std::vector< Group > groups;
+	bool any_fallback = false;
+
+	Group const &group(uint32_t p) const { return groups[polygons[p].group]; }
+	//index in polygon p of canonical corner k (canonical order starts at the lexicographically smallest corner and goes ccw):
+	uint32_t at(uint32_t p, uint32_t k) const {
+		Polygon const &o = polygons[p];
+		return o.reversed ? (o.start + o.size - k) % o.size : (o.start + k) % o.size;
+	}
+
+private:
+	struct Polygon {
+		uint32_t size = 0;
+		uint32_t start = 0;
+		bool reversed = false;
+		uint32_t group = -1U;
+	};
+	std::vector< Polygon > polygons;
 };
 
+struct StateValidator;
+
 struct State : public std::vector< Facet > {
+	//if set, fold_dest and refold report each change to it (see validator.hpp).
+	//It checks one particular state, so copies don't get it (moves do):
+	std::shared_ptr< StateValidator > validator;
+
+	State() = default;
+	State(State const &other) : std::vector< Facet >(other) { }
+	State(State &&other) = default;
+	State &operator=(State const &other) {
+		std::vector< Facet >::operator=(other);
+		validator.reset();
+		return *this;
+	}
+	State &operator=(State &&other) = default;
+
 	// return true if folding happened
 	bool fold_dest(K::Point_2 const &a, K::Point_2 const &b);
+	//the work behind fold_dest, for any list of facets: pieces are appended to 'pieces' (in facet order)
+	// and, if 'origin' is given, the index in 'facets' each piece came from to 'origin'.
+	static void fold_facets(std::vector< Facet const * > const &facets, K::Point_2 const &a, K::Point_2 const &b, State *pieces, std::vector< uint32_t > *origin, uint32_t *from_flip, uint32_t *from_noflip);
 	void unfold();
 	bool refold(std::vector< K::Point_2 > const &marks); //returns false and leaves facets in weird positions if marks isn't consistent
 	void print_solution(std::ostream& out) const;
@@ -30,5 +96,5 @@ struct State : public std::vector< Facet > {
 		std::ofstream file(filename);
 		print_solution(file);
 	}
-	State normalized() const;
+	State normalized(bool verbose = true) const; //(verbose prints what it did to std::cerr)
 };
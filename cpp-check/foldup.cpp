@@ -14,25 +14,41 @@
 #include <iostream>
 #include <unordered_map>
 #include <unordered_set>
+#include <thread>
 
 #include "structures.hpp"
 #include "folders.hpp"
-
-State make_square() {
-	State ret;
-	ret.clear();
-	ret.emplace_back();
-	ret.back().source.emplace_back(0,0);
-	ret.back().source.emplace_back(1,0);
-	ret.back().source.emplace_back(1,1);
-	ret.back().source.emplace_back(0,1);
-	ret.back().destination = ret.back().source;
-	ret.back().compute_xf();
-	assert(ret.back().flipped == false);
-	return ret;
-}
+#include "parallel.hpp"
+#include "mesh.hpp"
+#include "program.hpp"
+#include "validator.hpp"
 
 int main(int argc, char **argv) {
+	//folding runs on all cores unless told otherwise (the output doesn't depend on thread count):
+	uint32_t threads = std::thread::hardware_concurrency();
+	//echo every step and dump the facets at the end:
+	bool verbose = false;
+	//fold a State and check it after every fold (slower, but stops at the first bad fold):
+	bool validate = false;
+	while (argc >= 2) {
+		if (argc >= 3 && std::string(argv[1]) == "--threads") {
+			threads = std::atoi(argv[2]);
+			argc -= 2;
+			argv += 2;
+		} else if (std::string(argv[1]) == "--verbose") {
+			verbose = true;
+			argc -= 1;
+			argv += 1;
+		} else if (std::string(argv[1]) == "--validate") {
+			validate = true;
+			argc -= 1;
+			argv += 1;
+		} else {
+			break;
+		}
+	}
+	set_parallel_threads(threads);
+
 	std::string in_file, instructions_file, out_file;
 	if (argc == 3) {
 		in_file = "";
@@ -43,11 +59,12 @@ int main(int argc, char **argv) {
 		instructions_file = argv[2];
 		out_file = argv[3];
 	} else {
-		std::cerr << "Usage:\n./foldup [in.solution] instructions.folds out.solution\n" << std::endl;
+		std::cerr << "Usage:\n./foldup [--threads N] [--verbose] [--validate] [in.solution] instructions.folds out.solution\n" << std::endl;
 		return 1;
 	}
 
-	State state;
+	Mesh state;
+	State checked; //(used instead of 'state' with --validate)
 	if (argc == 4) {
 		std::unique_ptr< Solution > soln = Solution::read(in_file);
 		if (!soln) {
@@ -55,71 +72,45 @@ int main(int argc, char **argv) {
 			return 1;
 		}
 		std::cerr << "Starting with the folded state of '" << in_file << "'." << std::endl;
+		State start;
 		for (auto const &facet : soln->facets) {
 			Facet f;
 			for (auto index : facet) {
 				f.source.emplace_back(soln->source[index]);
-				f.destination.emplace_back(soln->source[index]);
 			}
-			f.compute_xf();
-			state.emplace_back(f);
+			f.compute_xf(f.source);
+			start.emplace_back(f);
 		}
+		if (validate) checked = start;
+		else state = Mesh(start);
 	} else {
 		std::cerr << "Starting with a square." << std::endl;
-		state = make_square();
+		if (validate) checked = state.to_state();
 	}
-
-	{
-		std::vector< K::Point_2 > marks;
-		std::cerr << "Applying instructions from '" << instructions_file << "'." << std::endl;
-		std::ifstream inst(instructions_file);
-		std::string line;
-		while (std::getline(inst, line)) {
-			std::cerr <<  "> " << line << std::endl;
-			for (uint32_t i = 0; i < line.size(); ++i) {
-				if (line[i] == '#') {
-					line = line.substr(0, i);
-					break;
-				}
-			}
-			std::istringstream str(line);
-			std::string tok;
-			if (!(str >> tok)) continue;
-			if (tok == "fold") {
-				CGAL::Gmpq x1,y1,x2,y2;
-				char comma1, comma2;
-				if (!(str >> x1 >> comma1 >> y1 >> x2 >> comma2 >> y2) || comma1 != ',' || comma2 != ',') {
-					std::cerr << "For 'fold' instruction, expecting x1,y1 x2,y2" << std::endl;
-					return 1;
-				}
-				state.fold_dest(K::Point_2(x1, y1), K::Point_2(x2, y2));
-				std::cerr << "  after fold, have " << state.size() << " facets." << std::endl;
-			} else if (tok == "unfold") {
-				state.unfold();
-				marks.clear();
-			} else if (tok == "mark") {
-				CGAL::Gmpq x,y;
-				char comma;
-				if (!(str >> x >> comma >> y) || comma != ',') {
-					std::cerr << "For 'mark' instruction, expecting x,y" << std::endl;
-					return 1;
-				}
-				marks.emplace_back(x,y);
-			} else if (tok == "refold") {
-				if (marks.empty()) {
-					std::cerr << "WARNING: refolding with no marks." << std::endl;
-				}
-				if (!state.refold(marks)) {
-					std::cerr << "WARNING: refolding failed." << std::endl;
-				}
-				marks.clear();
-			} else {
-				std::cerr << "ERROR: unknown folding instruction '" << tok << "'." << std::endl;
-			}
+	if (validate) {
+		checked.validator = std::make_shared< StateValidator >();
+		if (!checked.validator->reset(checked)) {
+			std::cerr << "Starting state is not valid." << std::endl;
+			return 1;
 		}
 	}
 
-	std::cerr << "Now have " << state.size() << " facets." << std::endl;
+	std::unique_ptr< FoldProgram > program = FoldProgram::compile(instructions_file, argc == 3);
+	if (!program) {
+		std::cerr << "Failed to compile instructions." << std::endl;
+		return 1;
+	}
+	std::cerr << "Applying " << program->instructions.size() << " instructions (" << program->folds << " folds) from '" << instructions_file << "'";
+	if (program->dropped) std::cerr << "; dropped " << program->dropped << " folds that fold nothing";
+	std::cerr << "." << std::endl;
+	if (!(validate ? program->run(checked, verbose) : program->run(state, verbose))) {
+		return 1;
+	}
+	if (validate) {
+		std::cerr << "Validated " << checked.validator->folds << " folds (" << checked.validator->checked << " facets checked)." << std::endl;
+	}
+
+	std::cerr << "Now have " << (validate ? checked.size() : state.faces.size()) << " facets." << std::endl;
 
 	auto pp = [](CGAL::Gmpq const &q) -> std::string {
 		std::ostringstream str;
@@ -130,19 +121,22 @@ int main(int argc, char **argv) {
 		return str.str();
 	};
 
-	//DEBUG:
-	for (auto const &facet : state) {
-		std::cerr << "   ------\n";
-		for (uint32_t i = 0; i < facet.source.size(); ++i) {
-			std::string src_name = pp(facet.source[i].x()) + "," + pp(facet.source[i].y());
-			std::string dst_name = pp(facet.destination[i].x()) + "," + pp(facet.destination[i].y());
-			std::cerr << "     " << src_name << " -> " << dst_name << "\n";
+	if (verbose) {
+		for (auto const &facet : (validate ? checked : state.to_state())) {
+			std::cerr << "   ------\n";
+			for (uint32_t i = 0; i < facet.source.size(); ++i) {
+				K::Point_2 destination = facet.destination(i);
+				std::string src_name = pp(facet.source[i].x()) + "," + pp(facet.source[i].y());
+				std::string dst_name = pp(destination.x()) + "," + pp(destination.y());
+				std::cerr << "     " << src_name << " -> " << dst_name << "\n";
+			}
 		}
+		std::cerr << "------\n";
 	}
-	std::cerr << "------\n";
 
 	std::ostringstream out;
-	state.print_solution(out);
+	if (validate) checked.print_solution(out);
+	else state.print_solution(out);
 
 	std::cout << out.str();
 
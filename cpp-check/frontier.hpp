@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+//Priority queue of items to expand, smallest value first (a binary heap).
+//Besides popping the minimum, it can pop the rank'th smallest item (rank 0 is the minimum) in
+// O(rank log rank + log n), which is what randomized selection wants: small ranks, big frontier.
+//Items with equal values come out in the order they were pushed.
+template< typename VALUE, typename ITEM >
+struct Frontier {
+	struct Entry {
+		VALUE value;
+		uint64_t order; //push order, breaks ties
+		ITEM item;
+		bool operator<(Entry const &o) const {
+			if (value < o.value) return true;
+			if (o.value < value) return false;
+			return order < o.order;
+		}
+	};
+
+	size_t size() const { return heap.size(); }
+	bool empty() const { return heap.empty(); }
+	void clear() { heap.clear(); }
+
+	VALUE const &min_value() const { assert(!heap.empty()); return heap[0].value; }
+
+	void push(VALUE const &value, ITEM const &item) {
+		heap.emplace_back(Entry{value, pushed++, item});
+		sift_up(heap.size() - 1);
+	}
+
+	//bulk insert; big batches are heapified all at once rather than sifted up one at a time:
+	void push(std::vector< std::pair< VALUE, ITEM > > const &items) {
+		size_t old_size = heap.size();
+		heap.reserve(old_size + items.size());
+		for (auto const &vi : items) {
+			heap.emplace_back(Entry{vi.first, pushed++, vi.second});
+		}
+		if (items.size() > old_size / 4) {
+			for (size_t i = heap.size() / 2; i-- > 0; ) {
+				sift_down(i);
+			}
+		} else {
+			for (size_t i = old_size; i < heap.size(); ++i) {
+				sift_up(i);
+			}
+		}
+	}
+
+	ITEM pop_min() {
+		return pop_rank(0);
+	}
+
+	//pop the rank'th smallest item (ranks past the end pop the largest):
+	ITEM pop_rank(uint32_t rank) {
+		assert(!heap.empty());
+		if (rank >= heap.size()) rank = heap.size() - 1;
+		size_t at = 0;
+		if (rank > 0) {
+			//walk the heap in order with a little heap of candidate indices:
+			auto later = [this](size_t a, size_t b) { return heap[b] < heap[a]; };
+			std::vector< size_t > candidates;
+			candidates.emplace_back(0);
+			for (uint32_t r = 0; r <= rank; ++r) {
+				std::pop_heap(candidates.begin(), candidates.end(), later);
+				at = candidates.back();
+				candidates.pop_back();
+				for (size_t c = 2 * at + 1; c <= 2 * at + 2 && c < heap.size(); ++c) {
+					candidates.emplace_back(c);
+					std::push_heap(candidates.begin(), candidates.end(), later);
+				}
+			}
+		}
+		ITEM ret = std::move(heap[at].item);
+		remove(at);
+		return ret;
+	}
+
+private:
+	std::vector< Entry > heap;
+	uint64_t pushed = 0;
+
+	void remove(size_t at) {
+		assert(at < heap.size());
+		if (at + 1 != heap.size()) {
+			heap[at] = std::move(heap.back());
+			heap.pop_back();
+			if (at > 0 && heap[at] < heap[(at - 1) / 2]) {
+				sift_up(at);
+			} else {
+				sift_down(at);
+			}
+		} else {
+			heap.pop_back();
+		}
+	}
+
+	void sift_up(size_t at) {
+		while (at > 0) {
+			size_t parent = (at - 1) / 2;
+			if (!(heap[at] < heap[parent])) break;
+			std::swap(heap[at], heap[parent]);
+			at = parent;
+		}
+	}
+
+	void sift_down(size_t at) {
+		while (true) {
+			size_t best = at;
+			size_t l = 2 * at + 1;
+			size_t r = 2 * at + 2;
+			if (l < heap.size() && heap[l] < heap[best]) best = l;
+			if (r < heap.size() && heap[r] < heap[best]) best = r;
+			if (best == at) break;
+			std::swap(heap[at], heap[best]);
+			at = best;
+		}
+	}
+};
@@ -2,10 +2,17 @@
 #include "structures.hpp"
 #include "rotations.hpp"
 #include "folders.hpp"
+#include "parallel.hpp"
+#include "flat.hpp"
+#include "raster.hpp"
+#include "validator.hpp"
 
 #include <CGAL/convex_hull_2.h>
 #include <CGAL/Boolean_set_operations_2.h>
 
+#include <cmath>
+#include <thread>
+
 /* fold_dest already does this, weirdly enough:
 K::Segment_2 extend (const K::Segment_2& seg) {
 	K::Vector_2 vec = seg.to_vector();
@@ -22,7 +29,7 @@ K::Segment_2 extend (const K::Segment_2& seg) {
 }
 */
 
-bool fold_excess (State& state, const CGAL::Polygon_2<K>& goal) {
+bool fold_excess (FlatState& state, const CGAL::Polygon_2<K>& goal) {
 	uint32_t old_facets = state.size();
 	for (auto ei = goal.edges_begin(); ei != goal.edges_end(); ++ei) {
 		//the goal is ccw oriented, so fold with reverse of edge, since fold flips 'left-of' stuff onto right:
@@ -33,8 +40,27 @@ bool fold_excess (State& state, const CGAL::Polygon_2<K>& goal) {
 }
 
 int main(int argc, char **argv) {
+	//folding runs on all cores unless told otherwise (the output doesn't depend on thread count):
+	uint32_t threads = std::thread::hardware_concurrency();
+	//check each folded candidate in full (StateValidator::reset) before writing it:
+	bool validate = false;
+	while (argc >= 2) {
+		if (argc >= 3 && std::string(argv[1]) == "--threads") {
+			threads = std::atoi(argv[2]);
+			argc -= 2;
+			argv += 2;
+		} else if (std::string(argv[1]) == "--validate") {
+			validate = true;
+			argc -= 1;
+			argv += 1;
+		} else {
+			break;
+		}
+	}
+	set_parallel_threads(threads);
+
 	if (argc != 2 && argc != 3) {
-		std::cerr << "Usage:\n\t./get-convex <problem> [solution-to-write]\n" << std::endl;
+		std::cerr << "Usage:\n\t./get-convex [--threads N] [--validate] <problem> [solution-to-write]\n" << std::endl;
 		return 1;
 	}
 
@@ -111,9 +137,10 @@ int main(int argc, char **argv) {
 	auto get_fold = [get_goal](K::Vector_2 const &x, K::Point_2 const &min, K::Point_2 const &max) -> State {
 		Facet square;
 		insert_square(K::Vector_2(1,0), CGAL::ORIGIN, back_inserter(square.source));
-		insert_square(x, min, back_inserter(square.destination));
-		square.compute_xf();
-		State state;
+		std::vector< K::Point_2 > destination;
+		insert_square(x, min, back_inserter(destination));
+		square.compute_xf(destination);
+		FlatState state;
 		state.push_back (square);
 
 		CGAL::Polygon_2<K> goal = get_goal(x, min, max);
@@ -127,7 +154,7 @@ int main(int argc, char **argv) {
 #ifndef NDEBUG
 		std::cerr << "Folded " << counter << " times in total." << std::endl;
 #endif
-		return state;
+		return state.to_state();
 	};
 
 	auto output = [&argv, argc] (std::string &str) -> void {
@@ -140,10 +167,53 @@ int main(int argc, char **argv) {
 		}
 	};
 
-	uint32_t best_count = UINT32_MAX;
-	CGAL::Gmpq best_score = 0;
-	std::string best_solution;
-	// TODO do the exact/approximate phases
+	//Rasterized goals are cheap to score, so estimate every direction first
+	// and only compute exact scores for those near the best estimate:
+	const uint32_t raster_resolution = 256; //cells per unit length
+	RasterScorer scorer(*problem, raster_resolution);
+	Raster hull_raster = scorer.blank();
+	hull_raster.fill(std::vector< K::Point_2 >(hull.vertices_begin(), hull.vertices_end()));
+
+	//how far off an estimate can be: rasterizing misplaces about one cell's width of area along every
+	// boundary (the silhouette's, and the goal's, which is inside the hull so no longer than its perimeter),
+	// relative to the union, which is at least the silhouette's area. Two estimates are compared, so double it:
+	double approx_slack;
+	{
+		auto perimeter = [](std::vector< K::Point_2 > const &poly) {
+			double ret = 0.0;
+			for (uint32_t i = 0; i < poly.size(); ++i) {
+				K::Vector_2 d = poly[(i+1)%poly.size()] - poly[i];
+				ret += std::sqrt(CGAL::to_double(d * d));
+			}
+			return ret;
+		};
+		double boundary = perimeter(std::vector< K::Point_2 >(hull.vertices_begin(), hull.vertices_end()));
+		for (auto const &poly : problem->silhouette) {
+			boundary += perimeter(poly);
+		}
+		double area = scorer.silhouette_count * scorer.silhouette.cell * scorer.silhouette.cell;
+		approx_slack = (area > 0.0 ? 2.0 * boundary * scorer.silhouette.cell / area : 1.0);
+		approx_slack = std::max(approx_slack, 0.05); //(and never closer than this)
+	}
+	std::cerr << "Skipping directions whose approximate score is more than " << approx_slack << " below the best." << std::endl;
+
+	auto get_approx_score = [&scorer,&hull_raster](K::Vector_2 const &x, K::Point_2 const &min) -> double {
+		std::vector< K::Point_2 > square;
+		insert_square(x, min, std::back_inserter(square));
+		Raster goal = scorer.blank();
+		goal.fill(square);
+		goal.intersect(hull_raster);
+		return scorer.score(goal);
+	};
+
+	struct Candidate {
+		K::Vector_2 x_dir;
+		K::Point_2 min, max;
+		double approx;
+	};
+	std::vector< Candidate > candidates;
+	candidates.reserve(x_dirs.size());
+	double best_approx = 0.0;
 	for (auto const &x_dir : x_dirs) {
 		assert(x_dir * x_dir == 1);
 		K::Vector_2 y_dir = prep(x_dir);
@@ -170,6 +240,29 @@ int main(int argc, char **argv) {
 			min_y = c - CGAL::Gmpq(1,2);
 			max_y = c + CGAL::Gmpq(1,2);
 		}
+		candidates.emplace_back();
+		candidates.back().x_dir = x_dir;
+		candidates.back().min = K::Point_2(min_x, min_y);
+		candidates.back().max = K::Point_2(max_x, max_y);
+		candidates.back().approx = get_approx_score(x_dir, candidates.back().min);
+		best_approx = std::max(best_approx, candidates.back().approx);
+	}
+	std::cerr << "Best approximate score is " << best_approx << "." << std::endl;
+
+	uint32_t best_count = UINT32_MAX;
+	CGAL::Gmpq best_score = 0;
+	std::string best_solution;
+	uint32_t skipped = 0;
+	for (auto const &candidate : candidates) {
+		if (candidate.approx < best_approx - approx_slack) {
+			++skipped;
+			continue;
+		}
+		K::Vector_2 const &x_dir = candidate.x_dir;
+		CGAL::Gmpq min_x = candidate.min.x();
+		CGAL::Gmpq min_y = candidate.min.y();
+		CGAL::Gmpq max_x = candidate.max.x();
+		CGAL::Gmpq max_y = candidate.max.y();
 		auto score = get_score(x_dir, K::Point_2(min_x, min_y), K::Point_2(max_x, max_y));
 		if (score >= best_score && score > 0) {
 			if (score > best_score) {
@@ -178,6 +271,10 @@ int main(int argc, char **argv) {
 			}
 
 			auto state = get_fold(x_dir, K::Point_2(min_x, min_y), K::Point_2(max_x, max_y)).normalized();
+			if (validate && !StateValidator().reset(state)) {
+				std::cerr << "ERROR: folding for direction " << x_dir << " gave an invalid state; skipping it." << std::endl;
+				continue;
+			}
 			std::string solution;
 			{
 				std::ostringstream out;
@@ -207,6 +304,7 @@ int main(int argc, char **argv) {
 			}
 		}
 	}
+	std::cerr << "Skipped " << skipped << " of " << candidates.size() << " directions based on approximate score." << std::endl;
 
 	return 0;
 }
@@ -0,0 +1,155 @@
+#include "grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SegmentGrid::SegmentGrid(std::vector< K::Segment_2 > const &segments_) : segments(segments_), checked(segments_.size(), 0) {
+	if (segments.empty()) {
+		cell_begin.assign(2, 0);
+		return;
+	}
+
+	double max_x, max_y;
+	min_x = max_x = CGAL::to_double(segments[0].source().x());
+	min_y = max_y = CGAL::to_double(segments[0].source().y());
+	for (auto const &s : segments) {
+		for (auto const &pt : {s.source(), s.target()}) {
+			double x = CGAL::to_double(pt.x());
+			double y = CGAL::to_double(pt.y());
+			min_x = std::min(min_x, x);
+			min_y = std::min(min_y, y);
+			max_x = std::max(max_x, x);
+			max_y = std::max(max_y, y);
+		}
+	}
+	//about one segment per cell:
+	size = std::max< uint32_t >(1, std::min< uint32_t >(256, uint32_t(std::ceil(std::sqrt(double(segments.size()))))));
+	cell = std::max(max_x - min_x, max_y - min_y) / size;
+	if (!(cell > 0.0)) cell = 1.0;
+
+	//cells overlapping each segment's bounding box (padded, so rounding can't leave a segment out of a cell it touches):
+	pad = cell * 1e-6;
+	boxes.reserve(segments.size());
+	for (auto const &s : segments) {
+		boxes.emplace_back(box(s));
+	}
+
+	cell_begin.assign(size * size + 1, 0);
+	for (auto const &b : boxes) {
+		uint32_t x0, y0, x1, y1;
+		cells(b, &x0, &y0, &x1, &y1);
+		for (uint32_t y = y0; y <= y1; ++y) {
+			for (uint32_t x = x0; x <= x1; ++x) {
+				cell_begin[y * size + x + 1] += 1;
+			}
+		}
+	}
+	for (uint32_t c = 0; c < size * size; ++c) {
+		cell_begin[c + 1] += cell_begin[c];
+	}
+	cell_items.resize(cell_begin.back());
+	std::vector< uint32_t > fill(cell_begin.begin(), cell_begin.end() - 1);
+	for (uint32_t i = 0; i < segments.size(); ++i) {
+		uint32_t x0, y0, x1, y1;
+		cells(boxes[i], &x0, &y0, &x1, &y1);
+		for (uint32_t y = y0; y <= y1; ++y) {
+			for (uint32_t x = x0; x <= x1; ++x) {
+				cell_items[fill[y * size + x]++] = i;
+			}
+		}
+	}
+}
+
+SegmentGrid::Box SegmentGrid::box(K::Segment_2 const &seg) const {
+	double sx = CGAL::to_double(seg.source().x()), sy = CGAL::to_double(seg.source().y());
+	double tx = CGAL::to_double(seg.target().x()), ty = CGAL::to_double(seg.target().y());
+	Box ret;
+	ret.min_x = std::min(sx, tx) - pad;
+	ret.min_y = std::min(sy, ty) - pad;
+	ret.max_x = std::max(sx, tx) + pad;
+	ret.max_y = std::max(sy, ty) + pad;
+	return ret;
+}
+
+void SegmentGrid::cells(Box const &b, uint32_t *x0, uint32_t *y0, uint32_t *x1, uint32_t *y1) const {
+	auto to_cell = [&](double v, double min) -> uint32_t {
+		return uint32_t(std::max(0.0, std::min(double(size - 1), std::floor((v - min) / cell))));
+	};
+	*x0 = to_cell(b.min_x, min_x);
+	*x1 = to_cell(b.max_x, min_x);
+	*y0 = to_cell(b.min_y, min_y);
+	*y1 = to_cell(b.max_y, min_y);
+}
+
+uint32_t SegmentGrid::nearest(K::Point_2 const &pt) const {
+	if (segments.empty()) return -1U;
+
+	++query;
+	uint32_t best = -1U;
+	CGAL::Gmpq best_len2 = 0;
+	auto check = [&](uint32_t i) {
+		if (checked[i] == query) return;
+		checked[i] = query;
+		CGAL::Gmpq len2 = CGAL::squared_distance(pt, segments[i]);
+		if (best == -1U || len2 < best_len2 || (len2 == best_len2 && i < best)) {
+			best = i;
+			best_len2 = len2;
+		}
+	};
+
+	double px = (CGAL::to_double(pt.x()) - min_x) / cell;
+	double py = (CGAL::to_double(pt.y()) - min_y) / cell;
+	if (!(px >= 0.0 && px < size && py >= 0.0 && py < size)) {
+		//off the grid; just check everything:
+		for (uint32_t i = 0; i < segments.size(); ++i) {
+			check(i);
+		}
+		return best;
+	}
+	int32_t cx = int32_t(px);
+	int32_t cy = int32_t(py);
+
+	//search rings of cells around pt's cell; segments not reached by ring r are at least r cells away:
+	for (int32_t r = 0; r <= int32_t(size); ++r) {
+		for (int32_t y = cy - r; y <= cy + r; ++y) {
+			if (y < 0 || y >= int32_t(size)) continue;
+			for (int32_t x = cx - r; x <= cx + r; ++x) {
+				if (x < 0 || x >= int32_t(size)) continue;
+				if (std::abs(x - cx) != r && std::abs(y - cy) != r) continue; //(inside the ring)
+				uint32_t c = y * size + x;
+				for (uint32_t k = cell_begin[c]; k < cell_begin[c + 1]; ++k) {
+					check(cell_items[k]);
+				}
+			}
+		}
+		if (best != -1U) {
+			double reach = r * cell;
+			if (CGAL::to_double(best_len2) < reach * reach * (1.0 - 1e-9)) break;
+		}
+	}
+	return best;
+}
+
+void SegmentGrid::overlapping(K::Segment_2 const &seg, std::vector< uint32_t > *out) const {
+	out->clear();
+	if (segments.empty()) return;
+
+	++query;
+	Box b = box(seg);
+	uint32_t x0, y0, x1, y1;
+	cells(b, &x0, &y0, &x1, &y1); //(cells clamp, so parts of seg off the grid land in the edge cells)
+	for (uint32_t y = y0; y <= y1; ++y) {
+		for (uint32_t x = x0; x <= x1; ++x) {
+			uint32_t c = y * size + x;
+			for (uint32_t k = cell_begin[c]; k < cell_begin[c + 1]; ++k) {
+				uint32_t i = cell_items[k];
+				if (checked[i] == query) continue;
+				checked[i] = query;
+				Box const &o = boxes[i];
+				if (o.max_x < b.min_x || b.max_x < o.min_x || o.max_y < b.min_y || b.max_y < o.min_y) continue;
+				out->emplace_back(i);
+			}
+		}
+	}
+	std::sort(out->begin(), out->end());
+}
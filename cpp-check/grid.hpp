@@ -0,0 +1,40 @@
+#pragma once
+
+#include "utils.hpp"
+
+#include <vector>
+
+//Uniform grid over a set of segments, for finding the segment nearest a point
+// without testing every segment.
+//Cells are binned with doubles; distances are compared exactly, so the answer is the same
+// as a linear scan over squared_distance(point, segment) (ties go to the lowest index).
+struct SegmentGrid {
+	SegmentGrid(std::vector< K::Segment_2 > const &segments); //(segments must outlive the grid)
+
+	//index of the nearest segment (-1U if there are no segments):
+	uint32_t nearest(K::Point_2 const &pt) const;
+
+	//indices, ascending, of the segments whose bounding boxes might touch seg's
+	// (a superset of the segments that touch seg, so exact tests on just these give the same answers as testing all):
+	void overlapping(K::Segment_2 const &seg, std::vector< uint32_t > *out) const;
+
+	std::vector< K::Segment_2 > const &segments;
+	double min_x = 0.0, min_y = 0.0;
+	double cell = 1.0;
+	uint32_t size = 1; //grid is size x size cells
+	//cell (x,y)'s segments are cell_items[cell_begin[y*size+x] .. cell_begin[y*size+x+1]):
+	std::vector< uint32_t > cell_begin;
+	std::vector< uint32_t > cell_items;
+
+private:
+	struct Box {
+		double min_x, min_y, max_x, max_y;
+	};
+	std::vector< Box > boxes; //per segment, padded
+	double pad = 0.0; //(so rounding can't leave a segment out of a cell or box it touches)
+	Box box(K::Segment_2 const &seg) const;
+	void cells(Box const &box, uint32_t *x0, uint32_t *y0, uint32_t *x1, uint32_t *y1) const;
+
+	mutable std::vector< uint32_t > checked; //per segment, last query that computed its distance
+	mutable uint32_t query = 0;
+};
@@ -0,0 +1,437 @@
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include "grid.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+Mesh::Mesh() {
+	source.emplace_back(0,0);
+	source.emplace_back(1,0);
+	source.emplace_back(1,1);
+	source.emplace_back(0,1);
+	destination = source;
+	for (uint32_t i = 0; i < 4; ++i) {
+		edges.emplace_back();
+		edges.back().vertex = i;
+		edges.back().next = (i + 1) % 4;
+		edges.back().facet = 0;
+	}
+	faces.emplace_back();
+	faces.back().edge = 0;
+}
+
+Mesh::Mesh(State const &state) {
+	std::unordered_map< K::Point_2, uint32_t, PointHash > vertex_idx;
+	std::unordered_map< uint64_t, uint32_t > edge_idx; //(min vertex, max vertex) -> first half-edge seen
+	std::vector< K::Point_2 > facet_destination;
+	for (auto const &facet : state) {
+		facet.destination(&facet_destination);
+		uint32_t f = faces.size();
+		faces.emplace_back();
+		faces.back().edge = edges.size();
+		faces.back().xf[0] = facet.xf[0];
+		faces.back().xf[1] = facet.xf[1];
+		faces.back().xf[2] = facet.xf[2];
+		faces.back().flipped = facet.flipped;
+
+		uint32_t first = edges.size();
+		for (uint32_t i = 0; i < facet.source.size(); ++i) {
+			auto ret = vertex_idx.insert(std::make_pair(facet.source[i], source.size()));
+			if (ret.second) {
+				source.emplace_back(facet.source[i]);
+				destination.emplace_back(facet_destination[i]);
+			}
+			assert(destination[ret.first->second] == facet_destination[i]);
+			edges.emplace_back();
+			edges.back().vertex = ret.first->second;
+			edges.back().next = (i + 1 < facet.source.size() ? edges.size() : first);
+			edges.back().facet = f;
+		}
+		for (uint32_t h = first; h < edges.size(); ++h) {
+			uint32_t v0 = edges[h].vertex;
+			uint32_t v1 = edges[edges[h].next].vertex;
+			uint64_t key = (uint64_t(std::min(v0, v1)) << 32) | uint64_t(std::max(v0, v1));
+			auto ret = edge_idx.insert(std::make_pair(key, h));
+			if (!ret.second) {
+				uint32_t other = ret.first->second;
+				assert(edges[other].twin == -1U && "edge shared by more than two facets");
+				edges[other].twin = h;
+				edges[h].twin = other;
+			}
+		}
+	}
+}
+
+State Mesh::to_state() const {
+	State state;
+	state.reserve(faces.size());
+	for (auto const &face : faces) {
+		state.emplace_back();
+		Facet &facet = state.back();
+		uint32_t h = face.edge;
+		do {
+			facet.source.emplace_back(source[edges[h].vertex]);
+			h = edges[h].next;
+		} while (h != face.edge);
+		facet.xf[0] = face.xf[0];
+		facet.xf[1] = face.xf[1];
+		facet.xf[2] = face.xf[2];
+		facet.flipped = face.flipped;
+	}
+	return state;
+}
+
+uint32_t Mesh::face_size(uint32_t f) const {
+	uint32_t count = 0;
+	uint32_t h = faces[f].edge;
+	do {
+		++count;
+		h = edges[h].next;
+	} while (h != faces[f].edge);
+	return count;
+}
+
+uint32_t Mesh::split_edge(uint32_t h, CGAL::Gmpq const &t) {
+	uint32_t v0 = edges[h].vertex;
+	uint32_t v1 = edges[edges[h].next].vertex;
+	uint32_t m = source.size();
+	source.emplace_back(source[v0] + (source[v1] - source[v0]) * t);
+	destination.emplace_back(destination[v0] + (destination[v1] - destination[v0]) * t);
+
+	//h: v0 -> m, h2: m -> v1
+	uint32_t h2 = edges.size();
+	edges.emplace_back();
+	edges[h2].vertex = m;
+	edges[h2].next = edges[h].next;
+	edges[h2].facet = edges[h].facet;
+	edges[h].next = h2;
+
+	uint32_t tw = edges[h].twin;
+	if (tw != -1U) {
+		//tw: v1 -> m, tw2: m -> v0
+		uint32_t tw2 = edges.size();
+		edges.emplace_back();
+		edges[tw2].vertex = m;
+		edges[tw2].next = edges[tw].next;
+		edges[tw2].facet = edges[tw].facet;
+		edges[tw].next = tw2;
+
+		edges[h].twin = tw2;
+		edges[tw2].twin = h;
+		edges[h2].twin = tw;
+		edges[tw].twin = h2;
+	}
+	return m;
+}
+
+uint32_t Mesh::split_face(uint32_t h0, uint32_t h1) {
+	uint32_t f = edges[h0].facet;
+	assert(edges[h1].facet == f);
+	assert(h0 != h1);
+
+	uint32_t prev0 = -1U;
+	uint32_t prev1 = -1U;
+	for (uint32_t h = h0; prev0 == -1U || prev1 == -1U; h = edges[h].next) {
+		if (edges[h].next == h0) prev0 = h;
+		if (edges[h].next == h1) prev1 = h;
+	}
+
+	//d1 closes h0 .. prev1 (the part that stays in f), d2 closes h1 .. prev0 (the new face):
+	uint32_t d1 = edges.size();
+	uint32_t d2 = d1 + 1;
+	edges.emplace_back();
+	edges.emplace_back();
+	edges[d1].vertex = edges[h1].vertex;
+	edges[d1].next = h0;
+	edges[d1].twin = d2;
+	edges[d1].facet = f;
+	edges[d2].vertex = edges[h0].vertex;
+	edges[d2].next = h1;
+	edges[d2].twin = d1;
+	edges[prev1].next = d1;
+	edges[prev0].next = d2;
+
+	uint32_t g = faces.size();
+	faces.emplace_back(faces[f]);
+	faces[f].edge = h0;
+	faces[g].edge = h1;
+	uint32_t h = h1;
+	do {
+		edges[h].facet = g;
+		h = edges[h].next;
+	} while (h != h1);
+	return g;
+}
+
+bool Mesh::fold_dest(K::Point_2 const &a, K::Point_2 const &b) {
+	assert(a != b);
+
+	K::Vector_2 along = b - a;
+	K::Vector_2 perp(-along.y(), along.x());
+
+	//everything on the 'perp' side of the line gets flipped:
+	K::Vector_2 flip_xf[3];
+	reflection_xf(a, b, flip_xf);
+
+	//signed distance (scaled) of each vertex from the line; positive gets flipped:
+	std::vector< CGAL::Gmpq > amt(destination.size());
+	parallel_for(destination.size(), [&](uint32_t v) {
+		amt[v] = perp * (destination[v] - a);
+	});
+
+	//faces that cross the line get split along it; only convex faces are handled here
+	// (non-convex faces can come from a starting solution), otherwise fall back to State:
+	//amt of each of face f's corners, in order (and the half-edges leaving them):
+	auto face_amt = [&](uint32_t f, std::vector< CGAL::Gmpq > *corners, std::vector< uint32_t > *halfedges) {
+		corners->clear();
+		if (halfedges) halfedges->clear();
+		uint32_t h = faces[f].edge;
+		do {
+			corners->emplace_back(amt[edges[h].vertex]);
+			if (halfedges) halfedges->emplace_back(h);
+			h = edges[h].next;
+		} while (h != faces[f].edge);
+	};
+	std::vector< uint8_t > fallback(faces.size(), 0);
+	parallel_for(faces.size(), [&](uint32_t f) {
+		std::vector< CGAL::Gmpq > corners;
+		std::vector< uint32_t > halfedges;
+		face_amt(f, &corners, &halfedges);
+		if (line_side(corners.data(), corners.size()) != BothSides) return;
+		std::vector< K::Point_2 > dst;
+		for (auto h : halfedges) {
+			dst.emplace_back(destination[edges[h].vertex]);
+		}
+		if (!is_convex(dst)) fallback[f] = 1;
+	});
+	if (std::find(fallback.begin(), fallback.end(), 1) != fallback.end()) {
+		State state = to_state();
+		bool ret = state.fold_dest(a, b);
+		*this = Mesh(state);
+		return ret;
+	}
+
+	//split edges that cross the line (splitting an edge also splits its twin):
+	for (uint32_t h = 0, count = edges.size(); h < count; ++h) {
+		if (edges[h].twin != -1U && edges[h].twin < h) continue;
+		CGAL::Gmpq t;
+		if (line_crossing(amt[edges[h].vertex], amt[edges[edges[h].next].vertex], &t)) {
+			split_edge(h, t);
+			amt.emplace_back(0);
+			assert(perp * (destination.back() - a) == 0);
+		}
+	}
+
+	//split faces that cross the line between the two vertices now on it:
+	std::vector< CGAL::Gmpq > corners;
+	std::vector< uint32_t > halfedges;
+	for (uint32_t f = 0, count = faces.size(); f < count; ++f) {
+		face_amt(f, &corners, &halfedges);
+		if (line_side(corners.data(), corners.size()) == BothSides) {
+			std::vector< uint32_t > on_line;
+			for (uint32_t k = 0; k < corners.size(); ++k) {
+				if (corners[k] == 0) on_line.emplace_back(halfedges[k]);
+			}
+			assert(on_line.size() == 2 && "convex face crosses line exactly twice");
+			//the flipped piece keeps the face's index (as with State::fold_dest, where it comes first;
+			// refold holds face 0 in place, so this keeps refold results the same):
+			if (amt[edges[edges[on_line[0]].next].vertex] > 0) {
+				split_face(on_line[0], on_line[1]);
+			} else {
+				split_face(on_line[1], on_line[0]);
+			}
+		}
+	}
+
+	//mirror vertices and faces on the flip side:
+	parallel_for(destination.size(), [&](uint32_t v) {
+		if (amt[v] > 0) {
+			destination[v] = apply_xf(flip_xf, destination[v]);
+		}
+	});
+
+	std::vector< uint8_t > face_flipped(faces.size(), 0);
+	parallel_for(faces.size(), [&](uint32_t f) {
+		Face &face = faces[f];
+		std::vector< CGAL::Gmpq > corners;
+		face_amt(f, &corners, nullptr);
+		LineSide side = line_side(corners.data(), corners.size());
+		assert(side != BothSides && "faces were split along the line");
+		if (side == FlipSide) {
+			compose_xf(flip_xf, face.xf, face.xf);
+			face.flipped = !face.flipped;
+			face_flipped[f] = 1;
+		}
+	});
+	uint32_t from_flip = std::count(face_flipped.begin(), face_flipped.end(), 1);
+	uint32_t from_noflip = faces.size() - from_flip;
+
+#ifndef NDEBUG
+	if (from_noflip == 0) {
+		std::cerr << "WARNING: folded *everything*" << std::endl;
+	}
+	if (from_flip == 0) {
+		std::cerr << "WARNING: folded *nothing*" << std::endl;
+	}
+#endif
+	return (from_flip > 0);
+}
+
+void Mesh::unfold() {
+	destination = source;
+	for (auto &face : faces) {
+		face.xf[0] = K::Vector_2(1,0);
+		face.xf[1] = K::Vector_2(0,1);
+		face.xf[2] = K::Vector_2(0,0);
+		face.flipped = false;
+	}
+}
+
+bool Mesh::refold(std::vector< K::Point_2 > const &marks) {
+	//tags per half-edge (kept the same on both twins):
+	enum Tag : uint8_t {
+		Outside,
+		Flat,
+		Fold
+	};
+	std::vector< Tag > tags(edges.size(), Outside);
+	for (uint32_t h = 0; h < edges.size(); ++h) {
+		if (edges[h].twin != -1U) tags[h] = Flat;
+	}
+
+	//one segment per edge (the lower-numbered half-edge of each twin pair):
+	std::vector< K::Segment_2 > segments;
+	std::vector< uint32_t > segment_edge;
+	for (uint32_t h = 0; h < edges.size(); ++h) {
+		if (edges[h].twin != -1U && edges[h].twin < h) continue;
+		segments.emplace_back(source[edges[h].vertex], source[edges[edges[h].next].vertex]);
+		segment_edge.emplace_back(h);
+	}
+	SegmentGrid grid(segments);
+
+	for (auto const &pt : marks) {
+		uint32_t close = grid.nearest(pt);
+		if (close != -1U) close = segment_edge[close];
+		if (close == -1U) {
+			std::cerr << "WARNING: mark at " << pt << " was far from everything." << std::endl;
+		} else if (tags[close] == Flat) {
+			tags[close] = Fold;
+			tags[edges[close].twin] = Fold;
+		} else if (tags[close] == Outside) {
+			std::cerr << "WARNING: mark at " << pt << " trying to mark outside edge." << std::endl;
+		} else {
+			std::cerr << "WARNING: mark at " << pt << " is marking an edge twice." << std::endl;
+		}
+	}
+
+	//walk outward from face 0, transforming based on folds:
+	std::vector< bool > done(faces.size(), false);
+	std::vector< uint32_t > to_expand;
+	faces[0].xf[0] = K::Vector_2(1,0);
+	faces[0].xf[1] = K::Vector_2(0,1);
+	faces[0].xf[2] = K::Vector_2(0,0);
+	faces[0].flipped = false;
+	done[0] = true;
+	to_expand.push_back(0);
+	while (!to_expand.empty()) {
+		uint32_t f = to_expand.back();
+		to_expand.pop_back();
+		uint32_t h = faces[f].edge;
+		do {
+			uint32_t tw = edges[h].twin;
+			if (tw != -1U) {
+				uint32_t g = edges[tw].facet;
+				K::Vector_2 other_xf[3];
+				bool other_flipped = faces[f].flipped;
+				if (tags[h] == Flat) {
+					other_xf[0] = faces[f].xf[0];
+					other_xf[1] = faces[f].xf[1];
+					other_xf[2] = faces[f].xf[2];
+				} else {
+					assert(tags[h] == Fold);
+					K::Point_2 xa = apply_xf(faces[f].xf, source[edges[h].vertex]);
+					K::Point_2 xb = apply_xf(faces[f].xf, source[edges[edges[h].next].vertex]);
+					K::Vector_2 flip_xf[3];
+					reflection_xf(xa, xb, flip_xf);
+					compose_xf(flip_xf, faces[f].xf, other_xf);
+					other_flipped = !other_flipped;
+				}
+				if (done[g]) {
+					if (!( faces[g].xf[0] == other_xf[0]
+						&& faces[g].xf[1] == other_xf[1]
+						&& faces[g].xf[2] == other_xf[2])) {
+						std::cerr << "ERROR: inconsistent marking; can't refold." << std::endl;
+						unfold(); //reset marking
+						return false;
+					}
+				} else {
+					faces[g].xf[0] = other_xf[0];
+					faces[g].xf[1] = other_xf[1];
+					faces[g].xf[2] = other_xf[2];
+					faces[g].flipped = other_flipped;
+					done[g] = true;
+					to_expand.push_back(g);
+				}
+			}
+			h = edges[h].next;
+		} while (h != faces[f].edge);
+	}
+	assert(std::find(done.begin(), done.end(), false) == done.end());
+
+	//faces agree along every edge, so they agree on shared vertices:
+	for (auto const &face : faces) {
+		uint32_t h = face.edge;
+		do {
+			destination[edges[h].vertex] = apply_xf(face.xf, source[edges[h].vertex]);
+			h = edges[h].next;
+		} while (h != face.edge);
+	}
+	return true;
+}
+
+void Mesh::print_solution(std::ostream& out) const {
+	auto pp = [](CGAL::Gmpq const &q) -> std::string {
+		std::ostringstream str;
+		str << q.numerator();
+		if (q.denominator() != 1) {
+			str << "/" << q.denominator();
+		}
+		return str.str();
+	};
+
+	//assign indices by count (as State::print_solution does):
+	std::vector< uint32_t > counts(source.size(), 0);
+	for (auto const &e : edges) {
+		counts[e.vertex] += 1;
+	}
+	std::vector< uint32_t > order;
+	for (uint32_t v = 0; v < source.size(); ++v) {
+		if (counts[v]) order.emplace_back(v);
+	}
+	std::stable_sort(order.begin(), order.end(), [&counts](uint32_t a, uint32_t b) {
+		return counts[a] > counts[b];
+	});
+	std::vector< uint32_t > index(source.size(), -1U);
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		index[order[i]] = i;
+	}
+
+	out << order.size() << "\n";
+	for (auto v : order) {
+		out << pp(source[v].x()) << "," << pp(source[v].y()) << "\n";
+	}
+	out << faces.size() << "\n";
+	for (uint32_t f = 0; f < faces.size(); ++f) {
+		out << face_size(f);
+		uint32_t h = faces[f].edge;
+		do {
+			out << " " << index[edges[h].vertex];
+			h = edges[h].next;
+		} while (h != faces[f].edge);
+		out << "\n";
+	}
+	for (auto v : order) {
+		out << pp(destination[v].x()) << "," << pp(destination[v].y()) << "\n";
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "utils.hpp"
+#include "structures.hpp"
+#include "folders.hpp"
+
+#include <vector>
+#include <iostream>
+
+//Folded state as a half-edge mesh over a shared vertex pool.
+//State gives every facet its own copy of its corners, so anything needing adjacency
+// (print_solution, refold, normalized) has to rediscover it by hashing coordinates;
+// here vertex identity and facet adjacency are kept up to date by fold_dest instead.
+struct Mesh {
+	//vertices (each has a single folded position, since the fold is continuous):
+	std::vector< K::Point_2 > source;
+	std::vector< K::Point_2 > destination;
+
+	//each facet is a loop of half-edges; twin is the half-edge along the same crease in the neighbouring facet:
+	struct HalfEdge {
+		uint32_t vertex; //start vertex
+		uint32_t next;
+		uint32_t twin = -1U; //-1U on the edge of the paper
+		uint32_t facet;
+	};
+	std::vector< HalfEdge > edges;
+
+	struct Face {
+		uint32_t edge; //any half-edge on the face's loop
+		//transform from source->destination as 2x3 (column major) matrix:
+		K::Vector_2 xf[3] = {
+			K::Vector_2(1,0),
+			K::Vector_2(0,1),
+			K::Vector_2(0,0)
+		};
+		bool flipped = false;
+	};
+	std::vector< Face > faces;
+
+	Mesh(); //unfolded unit square
+	explicit Mesh(State const &state);
+	State to_state() const;
+
+	uint32_t face_size(uint32_t f) const;
+
+	//same behavior as the State versions:
+	bool fold_dest(K::Point_2 const &a, K::Point_2 const &b);
+	void unfold();
+	bool refold(std::vector< K::Point_2 > const &marks);
+	void print_solution(std::ostream& out) const;
+	void print_solution(std::string const &filename) const {
+		std::ofstream file(filename);
+		print_solution(file);
+	}
+
+private:
+	//split half-edge h (and its twin) at parameter t, returning the new vertex:
+	uint32_t split_edge(uint32_t h, CGAL::Gmpq const &t);
+	//add a crease from the start of half-edge h0 to the start of h1 (same face); returns the new face:
+	uint32_t split_face(uint32_t h0, uint32_t h1);
+};
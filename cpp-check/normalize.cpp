@@ -1,10 +1,24 @@
-//search trees tries to unfold a problem by building a source from the facets of the skeleton.
+//normalize merges facets and picks the orientation with the shortest output:
+// ./normalize <solution> [file-to-write]
+// ./normalize --batch <directory|manifest> [--threads N] [--suffix S]
+//(e.g., ./normalize --batch ../reptiloid-db writes each solution's normalized copy next to it, as <file>-norm;
+// batches use all cores unless given --threads)
 
 #include "structures.hpp"
 #include "folders.hpp"
+#include "parallel.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <unordered_map>
 
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 
 #ifdef VIZ
 
@@ -68,34 +82,231 @@ void show(std::vector< std::tuple< glm::vec2, glm::vec2, glm::u8vec4 > > const &
 #endif //VIZ
 
 
+static State to_state(Solution const &input) {
+	State solution;
+	solution.reserve(input.facets.size());
+	for (auto const &f : input.facets) {
+		solution.emplace_back();
+		std::vector< K::Point_2 > destination;
+		for (uint32_t idx : f) {
+			solution.back().source.emplace_back(input.source[idx]);
+			destination.emplace_back(input.destination[idx]);
+		}
+		solution.back().compute_xf(destination);
+	}
+	return solution;
+}
+
+//solution size as the contest counts it (non-whitespace characters):
+static uint32_t graphic_count(std::string const &str) {
+	uint32_t count = 0;
+	for (char c : str) {
+		if (isgraph(c)) ++count;
+	}
+	return count;
+}
+
+static bool ends_with(std::string const &str, std::string const &end) {
+	return str.size() >= end.size() && str.compare(str.size() - end.size(), end.size(), end) == 0;
+}
+
+//all regular files under dir (recursively, skipping dot-files, symlinks, outputs, and leftover temporaries;
+// symlinks are skipped because they point at files the walk also finds, e.g. reptiloid's best_submitted):
+static void list_solutions(std::string const &dir, std::string const &suffix, std::vector< std::string > *files) {
+	DIR *d = opendir(dir.c_str());
+	if (!d) {
+		std::cerr << "WARNING: can't list directory '" << dir << "'." << std::endl;
+		return;
+	}
+	std::vector< std::string > names;
+	while (struct dirent *ent = readdir(d)) {
+		std::string name = ent->d_name;
+		if (name.empty() || name[0] == '.') continue;
+		names.emplace_back(name);
+	}
+	closedir(d);
+	std::sort(names.begin(), names.end());
+	for (auto const &name : names) {
+		std::string path = dir + "/" + name;
+		struct stat st;
+		if (lstat(path.c_str(), &st) != 0) continue;
+		if (S_ISLNK(st.st_mode)) continue;
+		if (S_ISDIR(st.st_mode)) {
+			list_solutions(path, suffix, files);
+		} else if (S_ISREG(st.st_mode)) {
+			if (!suffix.empty() && ends_with(name, suffix)) continue;
+			if (name.find(".tmp-") != std::string::npos) continue;
+			files->emplace_back(path);
+		}
+	}
+}
+
+//batch mode: normalize many solutions on the worker pool.
+//'from' is a directory (every file under it) or a manifest with one "input [output]" per line ('#' starts a comment).
+//Outputs default to input + suffix; each is written to a temporary and renamed into place, so an
+// interrupted run never leaves a partial solution behind.
+//Files that don't start with a number (e.g. READMEs and marker files in a directory) aren't
+// solutions, and are skipped rather than counted as failures.
+static int normalize_batch(std::string const &from, std::string const &suffix) {
+	std::vector< std::pair< std::string, std::string > > jobs; //input, output
+	struct stat st;
+	if (stat(from.c_str(), &st) != 0) {
+		std::cerr << "ERROR: can't find '" << from << "'." << std::endl;
+		return 1;
+	}
+	if (S_ISDIR(st.st_mode)) {
+		std::vector< std::string > files;
+		list_solutions(from, suffix, &files);
+		for (auto const &file : files) {
+			jobs.emplace_back(file, file + suffix);
+		}
+	} else {
+		std::ifstream manifest(from);
+		std::string line;
+		while (std::getline(manifest, line)) {
+			line = line.substr(0, line.find('#'));
+			std::istringstream str(line);
+			std::string input, output;
+			if (!(str >> input)) continue;
+			if (!(str >> output)) output = input + suffix;
+			jobs.emplace_back(input, output);
+		}
+	}
+	if (jobs.empty()) {
+		std::cerr << "WARNING: nothing to normalize in '" << from << "'." << std::endl;
+		return 0;
+	}
+	for (auto const &job : jobs) {
+		if (job.first == job.second) {
+			std::cerr << "ERROR: '" << job.first << "' would be written over; give --suffix or a separate output." << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector< uint32_t > before(jobs.size(), 0);
+	std::vector< uint32_t > after(jobs.size(), 0);
+	std::vector< uint8_t > ok(jobs.size(), 0);
+	std::vector< uint8_t > skipped(jobs.size(), 0);
+	std::mutex report_mutex;
+	parallel_for(jobs.size(), [&](uint32_t j) {
+		std::string const &input = jobs[j].first;
+		std::string const &output = jobs[j].second;
+
+		std::string text;
+		{
+			std::ifstream file(input, std::ios::binary);
+			if (!file) {
+				std::lock_guard< std::mutex > lock(report_mutex);
+				std::cerr << "ERROR: can't read '" << input << "'." << std::endl;
+				return;
+			}
+			std::ostringstream str;
+			str << file.rdbuf();
+			text = str.str();
+		}
+		before[j] = graphic_count(text);
+
+		{ //a solution starts with its vertex count:
+			size_t first = text.find_first_not_of(" \t\r\n");
+			if (first == std::string::npos || !isdigit(text[first])) {
+				skipped[j] = 1;
+				return;
+			}
+		}
+
+		std::unique_ptr< Solution > solution;
+		{
+			std::istringstream str(text);
+			//(read complains to std::cerr, so keep it from interleaving with other reports)
+			std::lock_guard< std::mutex > lock(report_mutex);
+			solution = Solution::read(str, input);
+		}
+		if (!solution) return;
+
+		std::ostringstream out;
+		to_state(*solution).normalized(false).print_solution(out);
+		std::string result = out.str();
+		after[j] = graphic_count(result);
+
+		std::string temp = output + ".tmp-" + std::to_string(getpid());
+		{
+			std::ofstream file(temp, std::ios::binary);
+			file << result;
+			file.close();
+			if (!file) {
+				std::lock_guard< std::mutex > lock(report_mutex);
+				std::cerr << "ERROR: failed to write '" << temp << "'." << std::endl;
+				std::remove(temp.c_str());
+				return;
+			}
+		}
+		if (std::rename(temp.c_str(), output.c_str()) != 0) {
+			std::lock_guard< std::mutex > lock(report_mutex);
+			std::cerr << "ERROR: failed to rename '" << temp << "' to '" << output << "'." << std::endl;
+			std::remove(temp.c_str());
+			return;
+		}
+		ok[j] = 1;
+
+		std::lock_guard< std::mutex > lock(report_mutex);
+		std::cout << input << ": " << before[j] << " -> " << after[j] << std::endl;
+	}, 1);
+
+	uint32_t done = 0;
+	uint32_t not_solutions = 0;
+	uint64_t total_before = 0, total_after = 0;
+	for (uint32_t j = 0; j < jobs.size(); ++j) {
+		if (skipped[j]) ++not_solutions;
+		if (!ok[j]) continue;
+		++done;
+		total_before += before[j];
+		total_after += after[j];
+	}
+	uint32_t solutions = jobs.size() - not_solutions;
+	std::cout << "Normalized " << done << " of " << solutions << " solutions (" << parallel_threads() << " threads); total size " << total_before << " -> " << total_after << "." << std::endl;
+	if (not_solutions) {
+		std::cout << "Skipped " << not_solutions << " files that aren't solutions." << std::endl;
+	}
+	return (done == solutions ? 0 : 1);
+}
+
 int main(int argc, char **argv) {
-	if (argc != 2 && argc != 3) {
-		std::cerr << "Usage:\n./normalize <solution> [file-to-write]" << std::endl;
+	//normalizing runs on all cores unless told otherwise (the output doesn't depend on thread count):
+	set_parallel_threads(std::thread::hardware_concurrency());
+	std::string batch;
+	std::string suffix = "-norm";
+	std::vector< std::string > args;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--batch" && i + 1 < argc) {
+			batch = argv[++i];
+		} else if (arg == "--threads" && i + 1 < argc) {
+			set_parallel_threads(std::atoi(argv[++i]));
+		} else if (arg == "--suffix" && i + 1 < argc) {
+			suffix = argv[++i];
+		} else {
+			args.emplace_back(arg);
+		}
+	}
+	if (batch != "" && args.empty()) {
+		return normalize_batch(batch, suffix);
+	}
+	if (batch != "" || (args.size() != 1 && args.size() != 2)) {
+		std::cerr << "Usage:\n./normalize <solution> [file-to-write]\n./normalize --batch <directory|manifest> [--threads N] [--suffix S]" << std::endl;
 		return 1;
 	}
-	std::unique_ptr< Solution > input = Solution::read(argv[1]);
+	std::unique_ptr< Solution > input = Solution::read(args[0]);
 	if (!input) {
 		std::cerr << "ERROR: Failed to read solution." << std::endl;
 		return 1;
 	}
 
-	State solution;
-	solution.reserve(input->facets.size());
-	for (auto const &f : input->facets) {
-		solution.emplace_back();
-		for (uint32_t idx : f) {
-			solution.back().source.emplace_back(input->source[idx]);
-			solution.back().destination.emplace_back(input->destination[idx]);
-		}
-		solution.back().compute_xf();
-	}
-
-	solution = solution.normalized();
+	State solution = to_state(*input).normalized();
 
 	//output the result:
-	if (argc == 3) {
-		std::cerr << "   (writing to " << argv[2] << ")" << std::endl;
-		solution.print_solution(argv[2]);
+	if (args.size() == 2) {
+		std::cerr << "   (writing to " << args[1] << ")" << std::endl;
+		solution.print_solution(args[1]);
 	} else {
 		solution.print_solution(std::cout);
 	}
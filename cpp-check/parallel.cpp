@@ -0,0 +1,132 @@
+#include "parallel.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//set on worker threads and on a thread running a loop, so nested loops run serially:
+static thread_local bool in_loop = false;
+
+struct Pool {
+	uint32_t threads = 1;
+	std::vector< std::thread > workers;
+
+	std::mutex job_mutex; //held by whichever thread is running a loop on the pool
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	//current loop:
+	std::function< void(uint32_t) > const *body = nullptr;
+	uint32_t count = 0;
+	std::atomic< uint32_t > next{0};
+	uint32_t generation = 0;
+	uint32_t busy = 0; //workers still working on the current loop
+	bool quit = false;
+
+	void run() {
+		uint32_t i;
+		while ((i = next.fetch_add(1)) < count) {
+			(*body)(i);
+		}
+	}
+
+	//(seen is the generation when the worker was started, so it can't miss the next loop)
+	void work(uint32_t seen) {
+		in_loop = true;
+		std::unique_lock< std::mutex > lock(mutex);
+		while (true) {
+			wake.wait(lock, [&](){ return quit || generation != seen; });
+			if (quit) return;
+			seen = generation;
+			lock.unlock();
+			run();
+			lock.lock();
+			assert(busy > 0);
+			if (--busy == 0) done.notify_all();
+		}
+	}
+
+	void start() {
+		assert(workers.empty());
+		quit = false;
+		for (uint32_t t = 1; t < threads; ++t) {
+			workers.emplace_back(&Pool::work, this, generation);
+		}
+	}
+
+	void stop() {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		for (auto &w : workers) {
+			w.join();
+		}
+		workers.clear();
+	}
+
+	~Pool() {
+		stop();
+	}
+};
+
+static Pool &pool() {
+	static Pool p;
+	return p;
+}
+
+void set_parallel_threads(uint32_t count) {
+	Pool &p = pool();
+	std::unique_lock< std::mutex > job(p.job_mutex);
+	p.stop();
+	p.threads = (count == 0 ? 1 : count);
+}
+
+uint32_t parallel_threads() {
+	return pool().threads;
+}
+
+void parallel_for(uint32_t count, std::function< void(uint32_t) > const &body, uint32_t min_count) {
+	Pool &p = pool();
+	auto serial = [&]() {
+		for (uint32_t i = 0; i < count; ++i) {
+			body(i);
+		}
+	};
+	if (p.threads <= 1 || count < min_count || in_loop) {
+		serial();
+		return;
+	}
+	std::unique_lock< std::mutex > job(p.job_mutex, std::try_to_lock);
+	if (!job.owns_lock()) {
+		//some other thread is using the pool:
+		serial();
+		return;
+	}
+	if (p.workers.empty()) p.start();
+
+	{
+		std::unique_lock< std::mutex > lock(p.mutex);
+		p.body = &body;
+		p.count = count;
+		p.next = 0;
+		p.busy = p.workers.size();
+		++p.generation;
+	}
+	p.wake.notify_all();
+
+	in_loop = true;
+	p.run();
+	in_loop = false;
+
+	{
+		std::unique_lock< std::mutex > lock(p.mutex);
+		p.done.wait(lock, [&](){ return p.busy == 0; });
+		p.body = nullptr;
+	}
+}
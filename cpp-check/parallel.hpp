@@ -0,0 +1,23 @@
+#pragma once
+
+#include <CGAL/config.h>
+
+#include <cstdint>
+#include <functional>
+
+//Small shared worker pool for data-parallel loops (fold_dest over facets, etc).
+//Loop bodies write results to per-index slots, so output doesn't depend on scheduling.
+//parallel_for called from inside a loop body (or while another thread's loop is running) runs serially.
+//NOTE: loop bodies copy CGAL number types between threads, which needs CGAL's thread-safe
+// reference counting (CGAL_HAS_THREADS; the default when building with -pthread):
+#if !defined(CGAL_HAS_THREADS)
+#error "parallel_for shares CGAL handles between threads; build with CGAL_HAS_THREADS (e.g. -pthread)."
+#endif
+
+//number of threads used by parallel_for (1 means everything runs serially on the calling thread):
+void set_parallel_threads(uint32_t count);
+uint32_t parallel_threads();
+
+//calls body(i) for every i in [0, count), returning when all calls are done;
+// loops shorter than min_count aren't worth waking the pool for:
+void parallel_for(uint32_t count, std::function< void(uint32_t) > const &body, uint32_t min_count = 64);
@@ -0,0 +1,207 @@
+#include "program.hpp"
+#include "sequence.hpp"
+#include "scoring.hpp"
+#include "validator.hpp"
+
+#include <fstream>
+#include <sstream>
+
+std::unique_ptr< FoldProgram > FoldProgram::compile(std::string const &filename, bool from_square) {
+	std::ifstream file(filename);
+	return compile(file, filename, from_square);
+}
+
+std::unique_ptr< FoldProgram > FoldProgram::compile(std::istream &file, std::string const &filename, bool from_square) {
+	uint32_t line_number = 0;
+	#define ERROR( X ) \
+		do { \
+			std::cerr << "ERROR compiling '" << filename << "' line " << line_number << ": " << X << std::endl; \
+			return std::unique_ptr< FoldProgram >(); \
+		} while(0)
+
+	if (!file) ERROR("failed to open file.");
+
+	std::unique_ptr< FoldProgram > ret(new FoldProgram);
+
+	//the folded outline is tracked (without facets) whenever it is known, to spot folds that move nothing:
+	FoldSequence outline;
+	bool outline_known = from_square;
+
+	std::vector< K::Point_2 > marks;
+
+	std::string line;
+	while (std::getline(file, line)) {
+		++line_number;
+		for (uint32_t i = 0; i < line.size(); ++i) {
+			if (line[i] == '#') {
+				line = line.substr(0, i);
+				break;
+			}
+		}
+		std::istringstream str(line);
+		std::string tok;
+		if (!(str >> tok)) continue;
+		if (tok == "fold") {
+			CGAL::Gmpq x1,y1,x2,y2;
+			char comma1, comma2;
+			if (!(str >> x1 >> comma1 >> y1 >> x2 >> comma2 >> y2) || comma1 != ',' || comma2 != ',') {
+				ERROR("for 'fold' instruction, expecting x1,y1 x2,y2");
+			}
+			K::Point_2 a(x1, y1);
+			K::Point_2 b(x2, y2);
+			if (a == b) ERROR("fold line needs two different points.");
+
+			if (outline_known) {
+				K::Vector_2 along = b - a;
+				K::Vector_2 perp(-along.y(), along.x());
+				//if the whole bounding box is on the kept side, so is the paper; otherwise check the outline:
+				K::Point_2 min, max;
+				outline.bbox(&min, &max);
+				bool moves = false;
+				for (auto const &c : {min, K::Point_2(max.x(), min.y()), max, K::Point_2(min.x(), max.y())}) {
+					if (perp * (c - a) > 0) {
+						moves = true;
+						break;
+					}
+				}
+				if (moves) {
+					moves = false;
+					for (auto const &piece : outline.outline()) {
+						for (auto const &pt : piece) {
+							if (perp * (pt - a) > 0) {
+								moves = true;
+								break;
+							}
+						}
+						if (moves) break;
+					}
+				}
+				if (!moves) {
+					++ret->dropped;
+					continue;
+				}
+				outline.fold(a, b);
+			}
+
+			if (ret->instructions.empty() || ret->instructions.back().op != FoldInstruction::Fold) {
+				ret->instructions.emplace_back();
+				ret->instructions.back().op = FoldInstruction::Fold;
+				ret->instructions.back().line = line_number;
+			}
+			ret->instructions.back().folds.emplace_back(a, b);
+			++ret->folds;
+		} else if (tok == "mark") {
+			CGAL::Gmpq x,y;
+			char comma;
+			if (!(str >> x >> comma >> y) || comma != ',') {
+				ERROR("for 'mark' instruction, expecting x,y");
+			}
+			marks.emplace_back(x,y);
+		} else if (tok == "refold") {
+			ret->instructions.emplace_back();
+			ret->instructions.back().op = FoldInstruction::Refold;
+			ret->instructions.back().marks = std::move(marks);
+			ret->instructions.back().line = line_number;
+			marks.clear();
+			//where the paper ends up depends on the crease pattern:
+			outline.clear();
+			outline_known = false;
+		} else if (tok == "unfold") {
+			ret->instructions.emplace_back();
+			ret->instructions.back().op = FoldInstruction::Unfold;
+			ret->instructions.back().line = line_number;
+			marks.clear();
+			outline.clear();
+			outline_known = true;
+		} else if (tok == "target") {
+			std::string target;
+			if (!(str >> target)) {
+				ERROR("for 'target' instruction, expecting a problem file");
+			}
+			ret->instructions.emplace_back();
+			ret->instructions.back().op = FoldInstruction::Target;
+			ret->instructions.back().filename = target;
+			ret->instructions.back().line = line_number;
+		} else {
+			std::cerr << "WARNING: '" << filename << "' line " << line_number << ": unknown folding instruction '" << tok << "'." << std::endl;
+		}
+	}
+	if (!marks.empty()) {
+		std::cerr << "WARNING: '" << filename << "' ends with " << marks.size() << " marks that are never refolded." << std::endl;
+	}
+	#undef ERROR
+
+	return ret;
+}
+
+//helpers so run() can work on either a Mesh or a State:
+static size_t facet_count(Mesh const &state) { return state.faces.size(); }
+static size_t facet_count(State const &state) { return state.size(); }
+static State as_state(Mesh const &state) { return state.to_state(); }
+static State const &as_state(State const &state) { return state; }
+static bool still_valid(Mesh const &) { return true; }
+static bool still_valid(State const &state) { return !state.validator || state.validator->ok; }
+
+template< typename STATE >
+static bool run_program(std::vector< FoldInstruction > const &instructions, STATE &state, bool verbose) {
+	std::unique_ptr< Problem > target;
+	std::unique_ptr< FoldScore > score;
+	auto print_score = [&score]() {
+		std::cerr << "  score is " << score->score() << " ~= " << CGAL::to_double(score->score()) << std::endl;
+	};
+
+	for (auto const &inst : instructions) {
+		if (inst.op == FoldInstruction::Fold) {
+			for (auto const &f : inst.folds) {
+				if (verbose) std::cerr << "> fold " << f.first << " " << f.second << std::endl;
+				state.fold_dest(f.first, f.second);
+				if (verbose) std::cerr << "  after fold, have " << facet_count(state) << " facets." << std::endl;
+				if (!still_valid(state)) {
+					std::cerr << "ERROR: fold " << (&f - &inst.folds[0]) + 1 << " of the run starting on line " << inst.line << " made the state invalid." << std::endl;
+					return false;
+				}
+				if (score) {
+					score->fold(f.first, f.second);
+					print_score();
+				}
+			}
+		} else if (inst.op == FoldInstruction::Unfold) {
+			if (verbose) std::cerr << "> unfold" << std::endl;
+			state.unfold();
+			if (target) score.reset(new FoldScore(*target, as_state(state)));
+		} else if (inst.op == FoldInstruction::Refold) {
+			if (verbose) std::cerr << "> refold (" << inst.marks.size() << " marks)" << std::endl;
+			if (inst.marks.empty()) {
+				std::cerr << "WARNING: refolding with no marks." << std::endl;
+			}
+			if (!state.refold(inst.marks)) {
+				std::cerr << "WARNING: refolding failed." << std::endl;
+			}
+			if (!still_valid(state)) {
+				std::cerr << "ERROR: refold on line " << inst.line << " made the state invalid." << std::endl;
+				return false;
+			}
+			if (target) score.reset(new FoldScore(*target, as_state(state)));
+		} else if (inst.op == FoldInstruction::Target) {
+			if (verbose) std::cerr << "> target " << inst.filename << std::endl;
+			target = Problem::read(inst.filename);
+			if (!target) {
+				std::cerr << "Failed to read target problem." << std::endl;
+				return false;
+			}
+			score.reset(new FoldScore(*target, as_state(state)));
+			print_score();
+		} else {
+			assert(0 && "unknown instruction");
+		}
+	}
+	return true;
+}
+
+bool FoldProgram::run(Mesh &state, bool verbose) const {
+	return run_program(instructions, state, verbose);
+}
+
+bool FoldProgram::run(State &state, bool verbose) const {
+	return run_program(instructions, state, verbose);
+}
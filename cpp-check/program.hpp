@@ -0,0 +1,48 @@
+#pragma once
+
+#include "structures.hpp"
+#include "mesh.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+
+//.folds instruction files, compiled:
+// fold x1,y1 x2,y2  -- fold (as State::fold_dest)
+// mark x,y          -- mark the crease nearest x,y for the next refold
+// refold            -- unfold and refold along the marked creases
+// unfold            -- unfold everything (and forget marks)
+// target problem    -- print the score against problem after each step
+//'#' starts a comment.
+//Consecutive folds share one instruction (still applied one at a time, in order), marks are attached
+// to the refold that uses them, and folds that provably move no paper (the "folded nothing" case)
+// are dropped at compile time.
+struct FoldInstruction {
+	enum Op {
+		Fold,
+		Unfold,
+		Refold,
+		Target
+	} op = Fold;
+	std::vector< std::pair< K::Point_2, K::Point_2 > > folds; //(Fold) run of consecutive folds, in order
+	std::vector< K::Point_2 > marks; //(Refold)
+	std::string filename; //(Target)
+	uint32_t line = 0; //line number in the source file (of the first fold, for runs of folds)
+};
+
+struct FoldProgram {
+	std::vector< FoldInstruction > instructions;
+	uint32_t folds = 0; //folds kept
+	uint32_t dropped = 0; //folds dropped because they provably fold nothing
+
+	//from_square says whether the program starts from the unfolded square (otherwise the
+	// starting outline isn't known, and folds are only dropped after an 'unfold'):
+	static std::unique_ptr< FoldProgram > compile(std::istream &file, std::string const &filename, bool from_square);
+	static std::unique_ptr< FoldProgram > compile(std::string const &filename, bool from_square);
+
+	//returns false if an instruction failed badly enough to stop (e.g., unreadable target):
+	bool run(Mesh &state, bool verbose = false) const;
+	//(State version also stops at the first fold its validator, if any, rejects)
+	bool run(State &state, bool verbose = false) const;
+};
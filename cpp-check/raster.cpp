@@ -0,0 +1,174 @@
+#include "raster.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//------------- Raster --------------------
+
+Raster::Raster(double min_x_, double min_y_, double cell_, uint32_t width_, uint32_t height_)
+	: min_x(min_x_), min_y(min_y_), cell(cell_), width(width_), height(height_) {
+	assert(cell > 0.0);
+	row_words = (width + 63) / 64;
+	bits.assign(size_t(row_words) * height, 0);
+}
+
+void Raster::clear() {
+	std::fill(bits.begin() + size_t(row_min) * row_words, bits.begin() + size_t(row_max) * row_words, 0);
+	row_min = row_max = 0;
+}
+
+void Raster::fill(std::vector< K::Point_2 > const &poly, Op op) {
+	std::vector< std::pair< double, double > > pts;
+	pts.reserve(poly.size());
+	for (auto const &pt : poly) {
+		pts.emplace_back(CGAL::to_double(pt.x()), CGAL::to_double(pt.y()));
+	}
+	fill(pts, op);
+}
+
+void Raster::fill(std::vector< std::pair< double, double > > const &poly, Op op) {
+	if (poly.size() < 3) return;
+
+	double lo = poly[0].second;
+	double hi = poly[0].second;
+	for (auto const &pt : poly) {
+		lo = std::min(lo, pt.second);
+		hi = std::max(hi, pt.second);
+	}
+	//rows whose centers are in [lo, hi]:
+	int64_t r0 = int64_t(std::ceil((lo - min_y) / cell - 0.5));
+	int64_t r1 = int64_t(std::floor((hi - min_y) / cell - 0.5));
+	r0 = std::max< int64_t >(r0, 0);
+	r1 = std::min< int64_t >(r1, int64_t(height) - 1);
+	if (r0 > r1) return;
+
+	if (row_min == row_max) {
+		row_min = r0;
+		row_max = r1 + 1;
+	} else {
+		row_min = std::min< uint32_t >(row_min, r0);
+		row_max = std::max< uint32_t >(row_max, r1 + 1);
+	}
+
+	std::vector< double > xs;
+	for (int64_t r = r0; r <= r1; ++r) {
+		double y = min_y + (r + 0.5) * cell;
+		xs.clear();
+		for (uint32_t i = 0; i < poly.size(); ++i) {
+			auto const &a = poly[i];
+			auto const &b = poly[(i+1)%poly.size()];
+			//half-open so vertices exactly on the sample line count once:
+			if ((a.second <= y) != (b.second <= y)) {
+				xs.emplace_back(a.first + (y - a.second) * (b.first - a.first) / (b.second - a.second));
+			}
+		}
+		std::sort(xs.begin(), xs.end());
+		uint64_t *row = &bits[size_t(r) * row_words];
+		for (uint32_t i = 0; i + 1 < xs.size(); i += 2) {
+			int64_t c0 = int64_t(std::ceil((xs[i] - min_x) / cell - 0.5));
+			int64_t c1 = int64_t(std::floor((xs[i+1] - min_x) / cell - 0.5));
+			c0 = std::max< int64_t >(c0, 0);
+			c1 = std::min< int64_t >(c1, int64_t(width) - 1);
+			if (c0 > c1) continue;
+			uint32_t w0 = c0 / 64;
+			uint32_t w1 = c1 / 64;
+			for (uint32_t w = w0; w <= w1; ++w) {
+				uint64_t mask = ~0ULL;
+				if (w == w0) mask &= ~0ULL << (c0 % 64);
+				if (w == w1 && (c1 % 64) != 63) mask &= (1ULL << ((c1 % 64) + 1)) - 1;
+				if (op == Or) {
+					row[w] |= mask;
+				} else {
+					assert(op == Xor);
+					row[w] ^= mask;
+				}
+			}
+		}
+	}
+}
+
+void Raster::intersect(Raster const &other) {
+	assert(other.width == width && other.height == height);
+	uint32_t lo = std::max(row_min, other.row_min);
+	uint32_t hi = std::min(row_max, other.row_max);
+	if (lo >= hi) {
+		clear();
+		return;
+	}
+	std::fill(bits.begin() + size_t(row_min) * row_words, bits.begin() + size_t(lo) * row_words, 0);
+	std::fill(bits.begin() + size_t(hi) * row_words, bits.begin() + size_t(row_max) * row_words, 0);
+	for (size_t i = size_t(lo) * row_words; i < size_t(hi) * row_words; ++i) {
+		bits[i] &= other.bits[i];
+	}
+	row_min = lo;
+	row_max = hi;
+}
+
+uint64_t Raster::count() const {
+	uint64_t ret = 0;
+	for (size_t i = size_t(row_min) * row_words; i < size_t(row_max) * row_words; ++i) {
+		ret += __builtin_popcountll(bits[i]);
+	}
+	return ret;
+}
+
+//------------- RasterScorer --------------------
+
+//a folded unit square fits in a disc of diameter sqrt(2), so this much border keeps anything touching the silhouette on the grid:
+static const double Border = 1.5;
+
+static Raster make_grid(Problem const &problem, uint32_t resolution) {
+	double lo_x = 0.0, lo_y = 0.0, hi_x = 0.0, hi_y = 0.0;
+	bool first = true;
+	for (auto const &poly : problem.silhouette) {
+		for (auto const &pt : poly) {
+			double x = CGAL::to_double(pt.x());
+			double y = CGAL::to_double(pt.y());
+			if (first) {
+				lo_x = hi_x = x;
+				lo_y = hi_y = y;
+				first = false;
+			}
+			lo_x = std::min(lo_x, x);
+			lo_y = std::min(lo_y, y);
+			hi_x = std::max(hi_x, x);
+			hi_y = std::max(hi_y, y);
+		}
+	}
+	double cell = 1.0 / std::max< uint32_t >(resolution, 1);
+	lo_x -= Border;
+	lo_y -= Border;
+	hi_x += Border;
+	hi_y += Border;
+	return Raster(lo_x, lo_y, cell, uint32_t(std::ceil((hi_x - lo_x) / cell)), uint32_t(std::ceil((hi_y - lo_y) / cell)));
+}
+
+RasterScorer::RasterScorer(Problem const &problem, uint32_t resolution) : silhouette(make_grid(problem, resolution)) {
+	//silhouette polygons are outer boundaries and holes, so flip each one in:
+	for (auto const &poly : problem.silhouette) {
+		silhouette.fill(poly, Raster::Xor);
+	}
+	silhouette_count = silhouette.count();
+}
+
+Raster RasterScorer::blank() const {
+	return Raster(silhouette.min_x, silhouette.min_y, silhouette.cell, silhouette.width, silhouette.height);
+}
+
+double RasterScorer::score(Raster const &candidate) const {
+	assert(candidate.width == silhouette.width && candidate.height == silhouette.height);
+	//only rows the candidate touches can contribute to the intersection:
+	uint64_t const *s = silhouette.bits.data();
+	uint64_t const *c = candidate.bits.data();
+	size_t begin = size_t(candidate.row_min) * candidate.row_words;
+	size_t end = size_t(candidate.row_max) * candidate.row_words;
+	uint64_t and_total = 0;
+	uint64_t c_total = 0;
+	for (size_t i = begin; i < end; ++i) {
+		and_total += __builtin_popcountll(s[i] & c[i]);
+		c_total += __builtin_popcountll(c[i]);
+	}
+	uint64_t or_total = silhouette_count + c_total - and_total;
+	if (or_total == 0) return 0.0;
+	return double(and_total) / double(or_total);
+}
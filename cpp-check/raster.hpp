@@ -0,0 +1,49 @@
+#pragma once
+
+#include "structures.hpp"
+
+#include <vector>
+
+//Approximate scoring by sampling polygons onto a grid of bits.
+//This is meant for ranking lots of candidates quickly; use Problem::get_score for the real score.
+
+struct Raster {
+	//grid of width x height cells with lower-left corner at (min_x, min_y); cells are sampled at their centers:
+	Raster(double min_x, double min_y, double cell, uint32_t width, uint32_t height);
+
+	double min_x, min_y;
+	double cell;
+	uint32_t width, height;
+	uint32_t row_words; //64-bit words per row
+	std::vector< uint64_t > bits;
+
+	//rows [row_min, row_max) may have set bits (lets scoring skip empty rows):
+	uint32_t row_min = 0;
+	uint32_t row_max = 0;
+
+	enum Op {
+		Or, //union in the polygon
+		Xor //flip the polygon (filling all boundaries of a polygon with holes this way gives the right result)
+	};
+	void fill(std::vector< K::Point_2 > const &poly, Op op = Or);
+	void fill(std::vector< std::pair< double, double > > const &poly, Op op = Or);
+	void intersect(Raster const &other); //keep only cells also set in other (same grid)
+	void clear();
+
+	uint64_t count() const;
+};
+
+struct RasterScorer {
+	//resolution is in cells per unit length; the grid covers the silhouette plus enough border
+	// that anything which overlaps the silhouette at all (and fits in a unit square) is not clipped.
+	RasterScorer(Problem const &problem, uint32_t resolution = 128);
+
+	Raster silhouette;
+	uint64_t silhouette_count = 0;
+
+	//approximate intersection-over-union of candidate with the silhouette:
+	double score(Raster const &candidate) const;
+
+	//empty raster with the same grid as the silhouette:
+	Raster blank() const;
+};
@@ -0,0 +1,106 @@
+#include "scoring.hpp"
+#include "utils.hpp"
+
+#include <list>
+
+FoldScore::FoldScore(Problem const &problem, State const &state) : silhouette(problem.get_silhouette()) {
+	for (auto const &facet : state) {
+		auto destination = facet.destination();
+		CGAL::Polygon_2< K > polygon(destination.begin(), destination.end());
+		if (polygon.orientation() == CGAL::CLOCKWISE) {
+			polygon.reverse_orientation();
+		}
+		solution.join(polygon);
+	}
+	overlap.intersection(solution, silhouette);
+
+	silhouette_area = polygon_set_area(silhouette);
+	solution_area = polygon_set_area(solution);
+	overlap_area = polygon_set_area(overlap);
+}
+
+void FoldScore::fold(K::Point_2 const &a, K::Point_2 const &b) {
+	assert(a != b);
+
+	std::list< CGAL::Polygon_with_holes_2< K > > polys;
+	solution.polygons_with_holes( std::back_inserter( polys ) );
+
+	//box covering everything left of a->b (same side fold_dest flips), in a + s * along + t * perp coordinates:
+	K::Vector_2 along = b - a;
+	K::Vector_2 perp(-along.y(), along.x());
+	auto len2 = along * along;
+	CGAL::Gmpq s_min = 0;
+	CGAL::Gmpq s_max = 1;
+	CGAL::Gmpq t_max = 1;
+	for (auto const &poly : polys) {
+		assert(!poly.is_unbounded());
+		auto const &outer = poly.outer_boundary();
+		for (auto vi = outer.vertices_begin(); vi != outer.vertices_end(); ++vi) {
+			auto s = ((*vi - a) * along) / len2;
+			auto t = ((*vi - a) * perp) / len2;
+			if (s < s_min) s_min = s;
+			if (s > s_max) s_max = s;
+			if (t > t_max) t_max = t;
+		}
+	}
+	s_min -= 1;
+	s_max += 1;
+	t_max += 1;
+	CGAL::Polygon_2< K > to_fold;
+	to_fold.push_back(a + along * s_min);
+	to_fold.push_back(a + along * s_max);
+	to_fold.push_back(a + along * s_max + perp * t_max);
+	to_fold.push_back(a + along * s_min + perp * t_max);
+	assert(to_fold.orientation() == CGAL::COUNTERCLOCKWISE);
+
+	CGAL::Polygon_set_2< K > moving = solution;
+	moving.intersection(to_fold);
+	if (moving.is_empty()) return; //folded nothing
+
+	K::Vector_2 flip_xf[3];
+	reflection_xf(a, b, flip_xf);
+	auto reflect = [&flip_xf](CGAL::Polygon_2< K > const &poly) {
+		CGAL::Polygon_2< K > ret;
+		for (auto vi = poly.vertices_begin(); vi != poly.vertices_end(); ++vi) {
+			ret.push_back(apply_xf(flip_xf, *vi));
+		}
+		ret.reverse_orientation(); //mirroring flips orientation, so flip it back
+		return ret;
+	};
+
+	CGAL::Polygon_set_2< K > mirrored;
+	{
+		std::list< CGAL::Polygon_with_holes_2< K > > res;
+		moving.polygons_with_holes( std::back_inserter( res ) );
+		for (auto const &poly : res) {
+			CGAL::Polygon_with_holes_2< K > flipped(reflect(poly.outer_boundary()));
+			for (auto hi = poly.holes_begin(); hi != poly.holes_end(); ++hi) {
+				flipped.add_hole(reflect(*hi));
+			}
+			mirrored.join(flipped);
+		}
+	}
+	auto moving_area = polygon_set_area(moving);
+
+	//what stays put (and its overlap) just loses the folded part:
+	solution.difference(to_fold);
+	overlap.difference(to_fold);
+	solution_area -= moving_area;
+	overlap_area = polygon_set_area(overlap);
+
+	//mirrored part adds its area, minus whatever lands on top of what stayed:
+	{
+		CGAL::Polygon_set_2< K > doubled;
+		doubled.intersection(solution, mirrored);
+		solution_area += moving_area - polygon_set_area(doubled);
+	}
+	{
+		CGAL::Polygon_set_2< K > mirrored_overlap;
+		mirrored_overlap.intersection(mirrored, silhouette);
+		CGAL::Polygon_set_2< K > doubled;
+		doubled.intersection(overlap, mirrored_overlap);
+		overlap_area += polygon_set_area(mirrored_overlap) - polygon_set_area(doubled);
+		overlap.join(mirrored_overlap);
+	}
+	solution.join(mirrored);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "structures.hpp"
+#include "folders.hpp"
+
+#include <CGAL/Polygon_set_2.h>
+
+//Keeps the exact score of a folded state current as folds are applied.
+//State::fold_dest(a,b) leaves everything right of a->b alone and mirrors everything left of it,
+// so the union of facets (and its overlap with the silhouette) only changes on the folded side.
+//This works on the union (usually a handful of polygons) rather than re-joining every facet.
+struct FoldScore {
+	FoldScore(Problem const &problem, State const &state);
+
+	CGAL::Polygon_set_2< K > silhouette;
+	CGAL::Polygon_set_2< K > solution; //union of facet destinations
+	CGAL::Polygon_set_2< K > overlap; //solution intersected with silhouette
+
+	K::FT silhouette_area = 0;
+	K::FT solution_area = 0;
+	K::FT overlap_area = 0;
+
+	//update for State::fold_dest(a,b) (call it whether or not the fold changed anything):
+	void fold(K::Point_2 const &a, K::Point_2 const &b);
+
+	K::FT score() const {
+		return overlap_area / (silhouette_area + solution_area - overlap_area);
+	}
+};
@@ -2,9 +2,12 @@
 
 #include "structures.hpp"
 #include "folders.hpp"
-#include "sha1.hpp"
+#include "frontier.hpp"
+#include "visited.hpp"
+#include "grid.hpp"
 #include "Viz1.hpp"
 
+#include <CGAL/config.h>
 #include <CGAL/Arrangement_2.h>
 #include <CGAL/Arr_segment_traits_2.h>
 #include <CGAL/Arr_curve_data_traits_2.h>
@@ -12,6 +15,15 @@
 #include <unordered_map>
 #include <random>
 #include <ctime>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+//--threads shares visited steps (and their Point_2 / Gmpq handles) between search threads:
+#if !defined(CGAL_HAS_THREADS)
+#error "search-trees --threads shares CGAL handles between threads; build with CGAL_HAS_THREADS (e.g. -pthread)."
+#endif
 
 typedef uint64_t Key;
 
@@ -28,56 +40,237 @@ struct SearchFace {
 	//CGAL::Gmpq area; //maybe?
 };
 
+//per-face geometry that seeding and expansion need, computed once after extraction.
+//Flattened: face f's corners are entries [face_begin[f], face_begin[f+1]), in boundary order,
+// and each edge entry is about the edge that starts at that corner.
+struct FaceGeometry {
+	std::vector< uint32_t > face_begin;
+	std::vector< K::Point_2 > corner;
+	std::vector< K::Vector_2 > along; //to the next corner
+	std::vector< K::Vector_2 > inward; //along rotated ccw (faces are ccw, so this points into the face)
+	std::vector< CGAL::Gmpq > inv_len2; //1 / (along * along)
+
+	//only edges of rational length can lie along the square's boundary, so only they get a frame:
+	std::vector< bool > rational;
+	std::vector< CGAL::Gmpq > length;
+	std::vector< K::Vector_2 > unit; //along / length
+	//extent of the face in the frame at corner with x along unit and y rotated ccw from it:
+	std::vector< CGAL::Gmpq > min_x, max_x, min_y, max_y;
+
+	uint32_t next(uint32_t f, uint32_t k) const {
+		return (k + 1 == face_begin[f+1] ? face_begin[f] : k + 1);
+	}
+};
+
+//State keys are zobrist-style: the xor of a hash per active edge and a hash per unused face,
+// so adding or cancelling an edge or using up a face updates the key in O(1).
+//The remaining area is hashed in as well: the same active edges and unused faces can enclose
+// different amounts of placed paper (faces can be placed more than once), and merging those
+// states can lose the only one that finishes.
+//(splitmix64 finalizer, so xor-ing hashes of similar edges doesn't cancel out structure)
+inline uint64_t mix64(uint64_t x) {
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+inline uint64_t face_hash(uint32_t face) {
+	return mix64(0x9e3779b97f4a7c15ULL * (uint64_t(face) + 1));
+}
+
+inline uint64_t area_hash(CGAL::Gmpz const &remaining_area) {
+	return mix64(hash_mpz(remaining_area.mpz()) ^ 0x632be59bd9b4e019ULL);
+}
+
+//set of faces, one bit per face in faces[]:
+struct FaceSet {
+	std::vector< uint64_t > bits;
+
+	void resize(uint32_t size) { bits.assign((size + 63) / 64, 0); }
+	bool test(uint32_t f) const { return (bits[f / 64] >> (f % 64)) & 1; }
+	void set(uint32_t f) { bits[f / 64] |= uint64_t(1) << (f % 64); }
+	void reset(uint32_t f) { bits[f / 64] &= ~(uint64_t(1) << (f % 64)); }
+	uint32_t count() const {
+		uint32_t ret = 0;
+		for (auto b : bits) {
+			ret += __builtin_popcountll(b);
+		}
+		return ret;
+	}
+};
+
 //unroll in source domain:
 struct ActiveEdge {
 	uint32_t edge = -1U; //edge in edges[]
 	K::Point_2 a,b; //points as they appear in edges[edge].a
 	//bool a_is_out = false; //is edges[edge].a the outward face?
 	bool perp_is_out = false; //is the ccw perpendicular direction the out direction?
+	uint64_t hash = 0; //from compute_hash()
+
+	//this was being slightly too good about disambiguating things when it sorted the endpoints.
+	// (so a and b are hashed in order)
+	uint64_t compute_hash() const {
+		size_t h = (size_t(edge) << 1) | (perp_is_out ? 1 : 0);
+		h = hash_combine(h, hash_gmpq(a.x()));
+		h = hash_combine(h, hash_gmpq(a.y()));
+		h = hash_combine(h, hash_gmpq(b.x()));
+		h = hash_combine(h, hash_gmpq(b.y()));
+		return mix64(h);
+	}
 };
 
 struct UnrollState {
-	uint64_t source_key = 0;
-	uint32_t added_face = -1U;
-	K::Vector_2 added_xf[3];
-
 	std::vector< ActiveEdge > active_edges;
 
-	std::set< uint32_t > unused_faces;
-	CGAL::Gmpq remaining_area = 1; //area left in source square
-	CGAL::Gmpq unused_face_area = 0; //total area of unused faces
+	FaceSet unused_faces;
+	//(areas are integers, in the units of face_areas)
+	CGAL::Gmpz remaining_area = 0; //area left in source square
+	CGAL::Gmpz unused_face_area = 0; //total area of unused faces
+
+	uint64_t edges_key = 0; //xor of active_edges' hashes
+	uint64_t unused_key = 0; //xor of face_hash() over unused_faces
 	
 	//create a key that uniquely identifies this unrolling step:
 	Key compute_key() const {
-		std::vector< std::string > names;
-		names.reserve(active_edges.size());
-		for (auto const &e : active_edges) {
-			std::ostringstream name;
-			//this was being slightly too good about disambiguating things when it sorted the endpoints.
-			name << e.perp_is_out << "|" << e.edge << "|" << e.a.x() << "|" << e.a.y() << "|" << e.b.x() << "|" << e.b.y();
-			//this is actually important!
-			for (auto i : unused_faces) {
-				name << "|" << i;
+		//(with no active edges, the unused faces aren't counted, so finished states look like the root)
+		if (active_edges.empty()) return 0;
+		//unused faces are part of the key -- this is actually important!
+		return edges_key ^ unused_key ^ area_hash(remaining_area);
+	}
+};
+
+//visited states aren't stored whole (copies of every active edge were what ran long searches out of memory);
+// instead each stores the step that made it from its parent, and is rebuilt by replaying steps:
+struct UnrollStep {
+	Key source_key = 0; //parent state
+	uint32_t added_face = -1U;
+	K::Vector_2 added_xf[3];
+
+	std::vector< ActiveEdge > added_edges; //edges of added_face that stay active (these come first in active_edges)
+	std::vector< uint32_t > cancelled_edges; //indices of the parent's active edges that added_face covered, ascending
+	bool used_face = false; //was added_face taken out of unused_faces?
+	uint32_t active_count = 0; //active_edges.size() after the step
+
+	CGAL::Gmpz remaining_area = 0;
+	CGAL::Gmpz unused_face_area = 0;
+	uint64_t edges_key = 0;
+	uint64_t unused_key = 0;
+
+	//same as UnrollState::compute_key() on the state after the step:
+	Key compute_key() const {
+		if (active_count == 0) return 0;
+		return edges_key ^ unused_key ^ area_hash(remaining_area);
+	}
+
+	//turn the parent state into this state:
+	void apply(UnrollState &state) const {
+		assert(state.active_edges.size() + added_edges.size() == active_count + cancelled_edges.size());
+		std::vector< ActiveEdge > active;
+		active.reserve(active_count);
+		active.insert(active.end(), added_edges.begin(), added_edges.end());
+		auto cancelled = cancelled_edges.begin();
+		for (uint32_t i = 0; i < state.active_edges.size(); ++i) {
+			if (cancelled != cancelled_edges.end() && *cancelled == i) {
+				++cancelled;
+				continue;
 			}
-			names.emplace_back(name.str());
+			active.emplace_back(std::move(state.active_edges[i]));
 		}
-		std::sort(names.begin(), names.end());
-		static SHA1_CTX ctx;
-		uint8_t digest[SHA1_DIGEST_SIZE];
+		assert(cancelled == cancelled_edges.end());
+		state.active_edges = std::move(active);
+
+		if (used_face) state.unused_faces.reset(added_face);
+		state.remaining_area = remaining_area;
+		state.unused_face_area = unused_face_area;
+		state.edges_key = edges_key;
+		state.unused_key = unused_key;
+		assert(state.compute_key() == compute_key());
+	}
+};
+
+//the last few states a search thread rebuilt; expansion mostly picks children of recently
+// expanded states, so a rebuild is usually a single step from here:
+struct StateCache {
+	static constexpr uint32_t Size = 64;
+	struct Entry {
+		Key key = 0;
+		uint64_t used = 0;
+		UnrollState state;
+	};
+	std::vector< Entry > entries;
+	uint64_t uses = 0;
 
-		SHA1_Init(&ctx);
-		for (auto const &name : names) {
-			SHA1_Update(&ctx, reinterpret_cast< const uint8_t * >(name.c_str()), name.size());
+	StateCache() { entries.reserve(Size); } //(so adding never moves other entries)
+
+	UnrollState const *find(Key key) {
+		for (auto &e : entries) {
+			if (e.key == key) {
+				e.used = ++uses;
+				return &e.state;
+			}
 		}
-		SHA1_Final(&ctx, digest);
+		return nullptr;
+	}
 
-		static_assert(SHA1_DIGEST_SIZE == 20, "digest is big enough");
-		uint64_t ret = 0;
-		for (uint32_t i = 0; i < 8; ++i) {
-			ret = (ret << 8) ^ digest[i];
+	//add (replacing the least recently used entry if full):
+	UnrollState const &add(Key key, UnrollState &&state) {
+		Entry *into;
+		if (entries.size() < Size) {
+			entries.emplace_back();
+			into = &entries.back();
+		} else {
+			into = &entries[0];
+			for (auto &e : entries) {
+				if (e.used < into->used) into = &e;
+			}
 		}
+		into->key = key;
+		into->used = ++uses;
+		into->state = std::move(state);
+		return into->state;
+	}
+};
 
-		return ret;
+//counters for the expansion loop; each search thread keeps its own, and they are summed for reporting:
+struct SearchStats {
+	std::atomic< uint32_t > expanded{0};
+	std::atomic< uint32_t > tried{0};
+	std::atomic< uint32_t > added{0};
+	std::atomic< uint32_t > repeat{0};
+	std::atomic< uint32_t > no_face_area{0};
+	std::atomic< uint32_t > no_other_area{0};
+	std::atomic< uint32_t > out_of_box{0};
+	std::atomic< uint32_t > intersection{0};
+	std::atomic< uint32_t > imperfect_overlap{0};
+	std::atomic< uint32_t > dead_ends{0};
+	std::atomic< uint32_t > rebuilt{0};
+	std::atomic< uint32_t > replayed{0};
+	void add(SearchStats const &o) {
+		expanded += o.expanded;
+		tried += o.tried;
+		added += o.added;
+		repeat += o.repeat;
+		no_face_area += o.no_face_area;
+		no_other_area += o.no_other_area;
+		out_of_box += o.out_of_box;
+		intersection += o.intersection;
+		imperfect_overlap += o.imperfect_overlap;
+		dead_ends += o.dead_ends;
+		rebuilt += o.rebuilt;
+		replayed += o.replayed;
+	}
+	void dump() const {
+		std::cerr << "Have expanded " << expanded << " states, tried to add " << tried << " and added " << added << ":\n"
+			<< "  " << repeat << " were already added\n"
+			<< "  " << no_face_area << " didn't have area for face\n"
+			<< "  " << no_other_area << " didn't have area for unused faces\n"
+			<< "  " << out_of_box << " were out of box\n"
+			<< "  " << intersection << " intersected active edges\n"
+			<< "  " << imperfect_overlap << " exactly overlapped different edges\n"
+			<< "  " << dead_ends << " discarded dead ends\n"
+			<< "Rebuilt " << rebuilt << " states by replaying " << replayed << " steps.\n"
+		;
+		std::cerr.flush();
 	}
 };
 
@@ -139,14 +332,28 @@ void show(std::vector< std::tuple< glm::vec2, glm::vec2, glm::u8vec4 > > const &
 
 std::vector< SearchEdge > edges;
 std::vector< SearchFace > faces;
-std::vector< CGAL::Gmpq > face_areas;
+//face areas, scaled by a common denominator so that area checks are integer comparisons:
+std::vector< CGAL::Gmpz > face_areas;
+CGAL::Gmpz square_area; //area of the unit source square in the same units
+FaceGeometry geometry;
 
 int main(int argc, char **argv) {
-	if (argc != 2 && argc != 3) {
-		std::cerr << "Usage:\n./search-trees <problem> [file-to-write]" << std::endl;
+	uint32_t threads = 1;
+	std::vector< std::string > args;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) {
+			threads = std::max(1, std::atoi(argv[++i]));
+		} else {
+			args.emplace_back(arg);
+		}
+	}
+	if (args.size() != 1 && args.size() != 2) {
+		std::cerr << "Usage:\n./search-trees [--threads N] <problem> [file-to-write]" << std::endl;
 		return 1;
 	}
-	std::string prob_name = argv[1];
+	std::string prob_name = args[0];
+	std::string out_name = (args.size() == 2 ? args[1] : "");
 	std::unique_ptr< Problem > problem = Problem::read(prob_name);
 	if (!problem) {
 		std::cerr << "ERROR: Failed to read problem." << std::endl;
@@ -323,120 +530,196 @@ int main(int argc, char **argv) {
 
 	std::cerr << "Extracted " << faces.size() << " faces and " << edges.size() << " edges." << std::endl;
 
-	face_areas.reserve(faces.size());
-	for (auto const &face : faces) {
-		CGAL::Polygon_2< K > poly(face.boundary.begin(), face.boundary.end());
-		assert(poly.orientation() == CGAL::COUNTERCLOCKWISE);
-		face_areas.emplace_back(poly.area());
-		//std::cerr << "  " <<  face_areas.back() << std::endl;//DEBUG
+	{ //face areas, in units of 1 / (lcm of their denominators):
+		std::vector< CGAL::Gmpq > areas;
+		areas.reserve(faces.size());
+		mpz_t scale;
+		mpz_init_set_ui(scale, 1);
+		for (auto const &face : faces) {
+			CGAL::Polygon_2< K > poly(face.boundary.begin(), face.boundary.end());
+			assert(poly.orientation() == CGAL::COUNTERCLOCKWISE);
+			areas.emplace_back(poly.area());
+			mpz_lcm(scale, scale, areas.back().denominator().mpz());
+			//std::cerr << "  " <<  areas.back() << std::endl;//DEBUG
+		}
+		square_area = CGAL::Gmpz(scale);
+		mpz_clear(scale);
+
+		face_areas.reserve(faces.size());
+		for (auto const &area : areas) {
+			CGAL::Gmpq scaled = area * CGAL::Gmpq(square_area);
+			assert(scaled.denominator() == 1);
+			face_areas.emplace_back(scaled.numerator());
+		}
 	}
 	assert(face_areas.size() == faces.size());
 
+	{ //tabulate per-corner geometry:
+		geometry.face_begin.reserve(faces.size() + 1);
+		geometry.face_begin.emplace_back(0);
+		for (auto const &face : faces) {
+			geometry.face_begin.emplace_back(geometry.face_begin.back() + face.boundary.size());
+		}
+		uint32_t corners = geometry.face_begin.back();
+		geometry.corner.resize(corners);
+		geometry.along.resize(corners);
+		geometry.inward.resize(corners);
+		geometry.inv_len2.resize(corners);
+		geometry.rational.assign(corners, false);
+		geometry.length.resize(corners);
+		geometry.unit.resize(corners);
+		geometry.min_x.resize(corners);
+		geometry.max_x.resize(corners);
+		geometry.min_y.resize(corners);
+		geometry.max_y.resize(corners);
+
+		for (uint32_t f = 0; f < faces.size(); ++f) {
+			auto const &boundary = faces[f].boundary;
+			for (uint32_t i = 0; i < boundary.size(); ++i) {
+				uint32_t k = geometry.face_begin[f] + i;
+				auto const &a = boundary[i];
+				auto const &b = boundary[(i + 1) % boundary.size()];
+				geometry.corner[k] = a;
+				geometry.along[k] = b - a;
+				geometry.inward[k] = geometry.along[k].perpendicular(CGAL::COUNTERCLOCKWISE);
+				CGAL::Gmpq len2 = geometry.along[k] * geometry.along[k];
+				assert(len2 > 0);
+				geometry.inv_len2[k] = 1 / len2;
+
+				//compute sqrt, if possible:
+				CGAL::Gmpz num2 = len2.numerator();
+				CGAL::Gmpz den2 = len2.denominator();
+				mpz_t num,den;
+				mpz_init(num);
+				mpz_init(den);
+				if (mpz_root(num, num2.mpz(), 2) != 0 && mpz_root(den, den2.mpz(), 2) != 0) {
+					geometry.rational[k] = true;
+					geometry.length[k] = CGAL::Gmpq(num, den);
+					geometry.unit[k] = geometry.along[k] * CGAL::Gmpq(den, num); //normalize
+					assert(geometry.unit[k] * geometry.unit[k] == 1);
+				}
+				mpz_clear(num);
+				mpz_clear(den);
+				if (!geometry.rational[k]) continue;
+
+				K::Vector_2 const &dir = geometry.unit[k];
+				K::Vector_2 perp = dir.perpendicular(CGAL::COUNTERCLOCKWISE);
+				CGAL::Gmpq min_x = 0;
+				CGAL::Gmpq max_x = 0;
+				CGAL::Gmpq min_y = 0;
+				CGAL::Gmpq max_y = 0;
+				for (auto const &pt : boundary) {
+					CGAL::Gmpq proj_x = dir * (pt - a);
+					CGAL::Gmpq proj_y = perp * (pt - a);
+					min_x = std::min(min_x, proj_x);
+					max_x = std::max(max_x, proj_x);
+					min_y = std::min(min_y, proj_y);
+					max_y = std::max(max_y, proj_y);
+				}
+				geometry.min_x[k] = min_x;
+				geometry.max_x[k] = max_x;
+				geometry.min_y[k] = min_y;
+				geometry.max_y[k] = max_y;
+			}
+		}
+	}
+
 
 	UnrollState root;
 	{
 		root.unused_face_area = 0;
+		root.unused_faces.resize(faces.size());
 		for (uint32_t f = 0; f < faces.size(); ++f) {
-			root.unused_faces.insert(f);
+			root.unused_faces.set(f);
+			root.unused_key ^= face_hash(f);
 			root.unused_face_area += face_areas[f];
 		}
-		root.remaining_area = 1;
+		root.remaining_area = square_area;
 		assert(root.remaining_area >= root.unused_face_area);
 	}
 	Key root_key = root.compute_key();
 
 	//root isn't in states because root also looks like "solved" and that confuses the code.
 
-	std::unordered_map< Key, UnrollState > states;
-
-	struct {
-		uint32_t expanded = 0;
-		uint32_t tried = 0;
-		uint32_t added = 0;
-		uint32_t repeat = 0;
-		uint32_t no_face_area = 0;
-		uint32_t no_other_area = 0;
-		uint32_t out_of_box = 0;
-		uint32_t intersection = 0;
-		uint32_t imperfect_overlap = 0;
-		uint32_t dead_ends = 0;
-		void dump() {
-			std::cerr << "Have expanded " << expanded << " states, tried to add " << tried << " and added " << added << ":\n"
-					<< "  " << repeat << " were already added\n"
-					<< "  " << no_face_area << " didn't have area for face\n"
-					<< "  " << no_other_area << " didn't have area for unused faces\n"
-					<< "  " << out_of_box << " were out of box\n"
-					<< "  " << intersection << " intersected active edges\n"
-					<< "  " << imperfect_overlap << " exactly overlapped different edges\n"
-					<< "  " << dead_ends << " discarded dead ends\n"
-				;
-				std::cerr.flush();
+	//visited states (as steps from their parents), shared by the search threads:
+	VisitedTable< UnrollStep > states;
+
+	std::deque< SearchStats > stats(threads); //per search thread
+	auto dump_stats = [&stats]() {
+		SearchStats total;
+		for (auto const &st : stats) {
+			total.add(st);
 		}
-	} stats;
+		total.dump();
+	};
+
+	//first solution found (by any thread) stops the search:
+	std::atomic< bool > stop(false);
+	std::mutex found_mutex;
+	std::unique_ptr< UnrollStep > found;
 
-	auto report = [&stats,&states,&root_key,&argc,&argv,&prob_name](UnrollState const &end) {
+	auto report = [&dump_stats,&states,&root_key,&out_name,&prob_name](UnrollStep const &end) {
 
-		stats.dump();
+		dump_stats();
 		std::cerr << " ----- found solution to [" << prob_name << "]-----" << std::endl;
 
 		assert(end.compute_key() == root_key); //solution always looks like root
 
 		State solution;
-		const UnrollState *at = &end;
+		const UnrollStep *at = &end;
 		while (true) {
 			assert(at->added_face < faces.size());
 			solution.emplace_back();
 			Facet &facet = solution.back();
-			for (auto const &d : faces[at->added_face].boundary) {
-				facet.destination.emplace_back(d);
+			auto const &destination = faces[at->added_face].boundary;
+			for (auto const &d : destination) {
 				facet.source.emplace_back(CGAL::ORIGIN + at->added_xf[0] * d.x() + at->added_xf[1] * d.y() + at->added_xf[2]);
 			}
-			assert(facet.source.size() == facet.destination.size());
 			//sanity check distances:
-			for (uint32_t i = 0; i < facet.destination.size(); ++i) {
-				for (uint32_t j = 0; j < facet.destination.size(); ++j) {
+			for (uint32_t i = 0; i < destination.size(); ++i) {
+				for (uint32_t j = 0; j < destination.size(); ++j) {
 					auto len2_src = (facet.source[i] - facet.source[j]) * (facet.source[i] - facet.source[j]);
-					auto len2_dst = (facet.destination[i] - facet.destination[j]) * (facet.destination[i] - facet.destination[j]);
+					auto len2_dst = (destination[i] - destination[j]) * (destination[i] - destination[j]);
 					assert(len2_src == len2_dst);
 				}
 			}
-			facet.compute_xf();
+			facet.compute_xf(std::vector< K::Point_2 >(destination.begin(), destination.end()));
 
 			if (at->source_key == root_key) break;
-			auto f = states.find(at->source_key);
-			assert(f != states.end());
-			at = &f->second;
+			at = states.find(at->source_key);
+			assert(at);
 		}
 #ifdef DEBUG_SOLN
 		{
 			std::vector< std::tuple< glm::vec2, glm::vec2, glm::u8vec4 > > lines;
 			for (auto const &facet : solution) {
+				auto destination = facet.destination();
 				for (uint32_t i = 0; i < facet.source.size(); ++i) {
 					lines.emplace_back(
 						to_glm(facet.source[i]), to_glm(facet.source[(i+1)%facet.source.size()]), glm::u8vec4(0xff, 0xff, 0xff, 0xff)
 					);
 					glm::vec2 ofs(2.0f, 0.0f);
 					lines.emplace_back(
-						to_glm(facet.destination[i]) + ofs, ofs + to_glm(facet.destination[(i+1)%facet.destination.size()]), glm::u8vec4(0x00, 0x00, 0x00, 0xff)
+						to_glm(destination[i]) + ofs, ofs + to_glm(destination[(i+1)%destination.size()]), glm::u8vec4(0x00, 0x00, 0x00, 0xff)
 					);
-					lines.emplace_back(to_glm(facet.source[i]), ofs + to_glm(facet.destination[i]), glm::u8vec4(0xff, 0x00, 0x00, 0x88));
+					lines.emplace_back(to_glm(facet.source[i]), ofs + to_glm(destination[i]), glm::u8vec4(0xff, 0x00, 0x00, 0x88));
 				}
 			}
 			show(lines);
 		}
 #endif
 
-		if (argc == 3) {
-			std::cerr << "   (writing to " << argv[2] << ")" << std::endl;
-			solution.print_solution(argv[2]);
+		if (out_name != "") {
+			std::cerr << "   (writing to " << out_name << ")" << std::endl;
+			solution.print_solution(out_name);
 		} else {
 			solution.print_solution(std::cout);
 		}
-		exit(0);
 	};
 
 	//helper to manage expanding states:
-	auto try_adding_face = [&stats, &states, &report](Key const &key, UnrollState const &us, uint32_t face_idx, K::Vector_2 (&xf)[3], std::unordered_map< Key, UnrollState > *new_states) -> bool {
+	//(active_grid indexes us.active_edges, in order)
+	auto try_adding_face = [&states, &stop, &found_mutex, &found](Key const &key, UnrollState const &us, SegmentGrid const &active_grid, uint32_t face_idx, K::Vector_2 (&xf)[3], std::unordered_map< Key, UnrollStep > *new_states, SearchStats &stats) -> bool {
 //#define DEBUG_ADD 1
 //#define DEBUG_SHOW 1
 
@@ -500,16 +783,20 @@ int main(int argc, char **argv) {
 		}
 		#endif //DEBUG_ADD
 
-		UnrollState ns = us;
-		ns.source_key = key;
-		ns.added_face = face_idx;
-		ns.added_xf[0] = xf[0];
-		ns.added_xf[1] = xf[1];
-		ns.added_xf[2] = xf[2];
+		UnrollStep step;
+		step.source_key = key;
+		step.added_face = face_idx;
+		step.added_xf[0] = xf[0];
+		step.added_xf[1] = xf[1];
+		step.added_xf[2] = xf[2];
+		step.remaining_area = us.remaining_area;
+		step.unused_face_area = us.unused_face_area;
+		step.edges_key = us.edges_key;
+		step.unused_key = us.unused_key;
 
 		{ //area check:
 			//is there enough area left to place this face?
-			if (ns.remaining_area < face_areas[face_idx]) {
+			if (step.remaining_area < face_areas[face_idx]) {
 				++stats.no_face_area;
 
 				#ifdef DEBUG_ADD
@@ -518,16 +805,16 @@ int main(int argc, char **argv) {
 
 				return false;
 			}
-			ns.remaining_area -= face_areas[face_idx];
+			step.remaining_area -= face_areas[face_idx];
 
-			auto f = ns.unused_faces.find(face_idx);
-			if (f != ns.unused_faces.end()) {
-				ns.unused_faces.erase(f);
-				assert(ns.unused_face_area >= face_areas[face_idx]);
-				ns.unused_face_area -= face_areas[face_idx];
+			if (us.unused_faces.test(face_idx)) {
+				step.used_face = true;
+				step.unused_key ^= face_hash(face_idx);
+				assert(step.unused_face_area >= face_areas[face_idx]);
+				step.unused_face_area -= face_areas[face_idx];
 			}
 			//is there enough area left for everything else?
-			if (ns.unused_face_area > ns.remaining_area) {
+			if (step.unused_face_area > step.remaining_area) {
 				++stats.no_other_area;
 
 				#ifdef DEBUG_ADD
@@ -540,19 +827,18 @@ int main(int argc, char **argv) {
 
 		//build active edges (and check for out-of-bounds):
 
-		std::vector< ActiveEdge > new_edges;
 		SearchFace const &face = faces[face_idx];
-		for (uint32_t fe = 0; fe < face.edges.size(); ++fe) {
-			K::Point_2 const &a = face.boundary[fe];
-			K::Point_2 const &b = face.boundary[(fe + 1) % face.boundary.size()];
-
-			K::Point_2 xa = CGAL::ORIGIN + xf[0] * a.x() + xf[1] * a.y() + xf[2];
-			K::Point_2 xb = CGAL::ORIGIN + xf[0] * b.x() + xf[1] * b.y() + xf[2];
-
-			if (xa.x() < 0 || xa.x() > 1
-			 || xa.y() < 0 || xa.y() > 1
-			 || xb.x() < 0 || xb.x() > 1
-			 || xb.y() < 0 || xb.x() > 1) {
+		uint32_t begin = geometry.face_begin[face_idx];
+		uint32_t end = geometry.face_begin[face_idx+1];
+
+		//corners in the source (each starts one edge and ends another, so transform them just once):
+		std::vector< K::Point_2 > xcorner;
+		xcorner.reserve(end - begin);
+		for (uint32_t k = begin; k < end; ++k) {
+			K::Point_2 const &c = geometry.corner[k];
+			xcorner.emplace_back(CGAL::ORIGIN + xf[0] * c.x() + xf[1] * c.y() + xf[2]);
+			K::Point_2 const &xc = xcorner.back();
+			if (xc.x() < 0 || xc.x() > 1 || xc.y() < 0 || xc.y() > 1) {
 				//xform takes face outside of valid source region
 				++stats.out_of_box;
 
@@ -562,6 +848,16 @@ int main(int argc, char **argv) {
 
 				return false;
 			}
+		}
+
+		//a face edge's outward side (cw of it) stays cw of the transformed edge unless xf is a reflection,
+		// in which case it ends up ccw -- so that's the same answer for every edge:
+		bool perp_is_out = (xf[0].x() * xf[1].y() - xf[0].y() * xf[1].x() < 0);
+
+		std::vector< ActiveEdge > new_edges;
+		for (uint32_t fe = 0; fe < face.edges.size(); ++fe) {
+			K::Point_2 const &xa = xcorner[fe];
+			K::Point_2 const &xb = xcorner[(fe + 1) % xcorner.size()];
 
 			//ignore boundary edges
 			if (
@@ -578,15 +874,6 @@ int main(int argc, char **argv) {
 			auto const &edge = edges[new_edges.back().edge];
 			assert(edge.a != -1U);
 
-			K::Vector_2 out = (b - a).perpendicular(CGAL::CLOCKWISE); //face is in ccw order
-			K::Vector_2 xout = xf[0] * out.x() + xf[1] * out.y();
-			bool perp_is_out;
-			{
-				auto d = xout * (xb - xa).perpendicular(CGAL::COUNTERCLOCKWISE);
-				auto len2 = (xb - xa) * (xb - xa);
-				assert(d == len2 || d == -len2);
-				perp_is_out = (d == len2);
-			}
 			if (edge.a == face_idx) {
 				new_edges.back().a = xa;
 				new_edges.back().b = xb;
@@ -610,18 +897,22 @@ int main(int argc, char **argv) {
 		// -> xformed edges *cross* active edges
 		// -> all xformed edges overlap existing face (this should be taken care of during input, as its hard to detect)
 		// -> xformed edges overlap boundary edges (sigh, we forget boundary edges so it's hard to check)
-		ns.active_edges.clear();
-		ns.active_edges.reserve(new_edges.size() + us.active_edges.size());
+		step.added_edges.reserve(new_edges.size());
 
 		std::vector< bool > cancel_active(us.active_edges.size(), false);
+		std::vector< uint32_t > nearby;
 		for (auto const &ne : new_edges) {
 			bool cancel = false;
-			for (auto const &ae : us.active_edges) {
+			//only active edges near ne can touch it (and they're checked in the same order as a scan of all of them):
+			active_grid.overlapping(K::Segment_2(ne.a, ne.b), &nearby);
+			for (uint32_t i : nearby) {
+				auto const &ae = us.active_edges[i];
 				if ( (ae.a == ne.a && ae.b == ne.b) || (ae.a == ne.b && ae.b == ne.a) ) {
 					if (ae.a == ne.a && ae.b == ne.b && ae.edge == ne.edge) {
 						//perfect overlap, edges cancel.
-						assert(!cancel_active[&ae - &us.active_edges[0]]);
-						cancel_active[&ae - &us.active_edges[0]] = true;
+						assert(!cancel_active[i]);
+						cancel_active[i] = true;
+						step.edges_key ^= ae.hash;
 						assert(!cancel);
 						cancel = true;
 						break; //assume that perfect overlap implies no further problems
@@ -650,19 +941,20 @@ int main(int argc, char **argv) {
 				}
 			}
 			if (!cancel) {
-				ns.active_edges.emplace_back(ne);
+				step.added_edges.emplace_back(ne);
+				step.added_edges.back().hash = ne.compute_hash();
+				step.edges_key ^= step.added_edges.back().hash;
 			}
 		}
-		for (auto const &ae : us.active_edges) {
-			if (!cancel_active[&ae - &us.active_edges[0]]) {
-				ns.active_edges.emplace_back(ae);
-			}
+		for (uint32_t i = 0; i < us.active_edges.size(); ++i) {
+			if (cancel_active[i]) step.cancelled_edges.emplace_back(i);
 		}
+		step.active_count = us.active_edges.size() - step.cancelled_edges.size() + step.added_edges.size();
 
-		Key ns_key = ns.compute_key();
-		//std::cout << ns_key << " from " << ns.source_key << std::endl; //DEBUG
-		if (!states.count(ns_key)) {
-			if (!new_states || new_states->insert(std::make_pair(ns_key, ns)).second) {
+		Key ns_key = step.compute_key();
+		//std::cout << ns_key << " from " << step.source_key << std::endl; //DEBUG
+		if (!states.contains(ns_key)) {
+			if (!new_states || new_states->insert(std::make_pair(ns_key, step)).second) {
 				++stats.added;
 
 				#ifdef DEBUG_ADD
@@ -670,17 +962,19 @@ int main(int argc, char **argv) {
 				#endif
 
 
-				//std::cout << "adding with: "<< ns.remaining_area << std::endl; //DEBUG
+				//std::cout << "adding with: "<< step.remaining_area << std::endl; //DEBUG
 
-				if (ns.remaining_area == 0) {
-					assert(ns.unused_faces.empty()); //otherwise would have bailed already
+				if (step.remaining_area == 0) {
+					assert(us.unused_faces.count() == (step.used_face ? 1U : 0U)); //otherwise would have bailed already
 
 					#ifdef DEBUG_ADD
 					std::cerr << " !! solution" << std::endl;
 					show(show_lines, false);
 					#endif //DEBUG_ADD
 
-					report(ns);
+					std::lock_guard< std::mutex > lock(found_mutex);
+					if (!found) found.reset(new UnrollStep(step));
+					stop = true;
 				}
 
 				return true;
@@ -701,7 +995,10 @@ int main(int argc, char **argv) {
 
 
 
+	std::unordered_map< Key, UnrollStep > seeds;
 	{ //seed with all possible bottom-left edges:
+		std::vector< K::Segment_2 > no_segments;
+		SegmentGrid root_grid(no_segments); //(root has no active edges)
 
 		struct {
 			uint32_t made = 0;
@@ -730,44 +1027,23 @@ int main(int argc, char **argv) {
 				//Figure out how to map this edge to the x-axis.
 				//note: an irrational-length edge can't appear on the boundary,
 				// so if no mapping exists don't use this as a seed edge.
-				auto const &a = face.boundary[fe];
-				auto const &b = face.boundary[(fe + 1) % face.boundary.size()];
+				uint32_t k = geometry.face_begin[f] + fe;
+				auto const &a = geometry.corner[k];
+				auto const &b = geometry.corner[geometry.next(f, k)];
 				//std::cerr << "  " << a << " to " << b << std::endl; //DEBUG
-				K::Vector_2 dir(b-a);
-				CGAL::Gmpq len2 = dir * dir;
-				CGAL::Gmpz num2 = len2.numerator();
-				CGAL::Gmpz den2 = len2.denominator();
-				mpz_t num,den;
-				mpz_init(num);
-				mpz_init(den);
-				//compute sqrt, if possible:
-				if (mpz_root(num, num2.mpz(), 2) == 0 || mpz_root(den, den2.mpz(), 2) == 0) {
-					mpz_clear(num);
-					mpz_clear(den);
+				if (!geometry.rational[k]) {
 					++seed_stats.irrational;
 					//std::cerr << "  (irrational)" << std::endl; //DEBUG
 					continue;
 				}
-				dir = dir * CGAL::Gmpq(den, num); //normalize
-				mpz_clear(num);
-				mpz_clear(den);
-				assert(dir * dir == 1);
-
+				K::Vector_2 const &dir = geometry.unit[k];
 				K::Vector_2 perp = dir.perpendicular(CGAL::COUNTERCLOCKWISE);
 
 				//make sure this direction works:
-				CGAL::Gmpq min_x = 0;
-				CGAL::Gmpq max_x = 0;
-				CGAL::Gmpq min_y = 0;
-				CGAL::Gmpq max_y = 0;
-				for (auto const &pt : face.boundary) {
-					CGAL::Gmpq proj_x = dir * (pt - a);
-					CGAL::Gmpq proj_y = perp * (pt - a);
-					min_x = std::min(min_x, proj_x);
-					max_x = std::max(max_x, proj_x);
-					min_y = std::min(min_y, proj_y);
-					max_y = std::max(max_y, proj_y);
-				}
+				CGAL::Gmpq const &min_x = geometry.min_x[k];
+				CGAL::Gmpq const &max_x = geometry.max_x[k];
+				CGAL::Gmpq const &min_y = geometry.min_y[k];
+				CGAL::Gmpq const &max_y = geometry.max_y[k];
 				//std::cerr << "    x: [" << min_x << ", " << max_x << "]" << std::endl; //DEBUG
 				//std::cerr << "    y: [" << min_y << ", " << max_y << "]" << std::endl; //DEBUG
 				if (min_y < 0) {
@@ -788,7 +1064,7 @@ int main(int argc, char **argv) {
 
 				bool corner = false;
 
-				if (min_x == dir * (a - a)) {
+				if (min_x == 0) {
 					corner = true;
 					//std::cerr << "  making [a->b]" << std::endl; //DEBUG
 					
@@ -806,11 +1082,11 @@ int main(int argc, char **argv) {
 					assert(CGAL::ORIGIN + xf[0] * dir.x() + xf[1] * dir.y() == K::Point_2(1,0));
 					assert(CGAL::ORIGIN + xf[0] * perp.x() + xf[1] * perp.y() == K::Point_2(0,1));
 
-					bool feasible = try_adding_face(root_key, root, f, xf, &states);
+					bool feasible = try_adding_face(root_key, root, root_grid, f, xf, &seeds, stats[0]);
 					assert(feasible);
 					++seed_stats.made;
 				}
-				if (max_x == dir * (b - a)) {
+				if (max_x == geometry.length[k]) {
 					corner = true;
 					//flipped-direction works for this edge
 					//std::cerr << "  making [b->a]" << std::endl; //DEBUG
@@ -828,7 +1104,7 @@ int main(int argc, char **argv) {
 					xf[1] = to_dir * dir.y() + to_perp * perp.y();
 					xf[2] = to_b - (xf[0] * b.x() + xf[1] * b.y());
 
-					bool feasible = try_adding_face(root_key, root, f, xf, &states);
+					bool feasible = try_adding_face(root_key, root, root_grid, f, xf, &seeds, stats[0]);
 					assert(feasible);
 					++seed_stats.made_flipped;
 				}
@@ -846,8 +1122,8 @@ int main(int argc, char **argv) {
 	//always expands the thing with the smallest expand value...
 	//Fill in area:
 	typedef double ExpandValue;
-	auto get_expand_value = [](UnrollState const &us) -> ExpandValue {
-		return CGAL::to_double(us.remaining_area);
+	auto get_expand_value = [](UnrollStep const &step) -> ExpandValue {
+		return CGAL::to_double(CGAL::Gmpq(step.remaining_area, square_area)); //(fraction of the square left)
 	};
 #if 0
 	//From lower left:
@@ -866,78 +1142,78 @@ int main(int argc, char **argv) {
 	};
 #endif
 
-	//TODO: consider a priority queue
-	std::multimap< ExpandValue, Key > to_expand;
-	for (auto const &kv : states) {
-		assert(kv.first != root_key); //root shouldn't be in states
-		to_expand.insert(std::make_pair(get_expand_value(kv.second), kv.first));
-	}
-
-
-	while (!to_expand.empty()) {
-		{
-			static uint32_t count = 0;
-			++count;
-			if (count == 1000) {
-				stats.dump();
-				count = 0;
+	//each search thread expands states from its own frontier, and steals from the others when it runs dry:
+	struct Worker {
+		std::mutex mutex; //guards frontier
+		Frontier< ExpandValue, Key > frontier;
+		std::mt19937 mt;
+		StateCache cache;
+	};
+	std::deque< Worker > workers(threads);
+	//states waiting in some frontier or being expanded (the search is over when this reaches zero):
+	std::atomic< uint64_t > pending(0);
+	if (!stop) { //remember the seeds and hand them out:
+		std::vector< std::vector< std::pair< ExpandValue, Key > > > initial(threads);
+		uint32_t next = 0;
+		for (auto const &kv : seeds) {
+			assert(kv.first != root_key); //root shouldn't be in states
+			if (states.insert(kv.first, kv.second).second) {
+				initial[next].emplace_back(get_expand_value(kv.second), kv.first);
+				next = (next + 1) % threads;
 			}
 		}
-		Key key;
-		{
-			auto sel = to_expand.begin();
-			static std::mt19937 mt(std::clock());
-//-----= RANDOMIZATION SPOT =------
+		for (uint32_t w = 0; w < threads; ++w) {
+			workers[w].frontier.push(initial[w]);
+			pending += initial[w].size();
+			workers[w].mt.seed(std::clock() + w);
+		}
+	}
 
-/*
-			//(JIM sez: this seems like a pessimal option)
-			//Simple, fully random, expansion order:
-			// --> this makes things a *lot* slower
-			uint32_t inc = mt() % to_expand.size();
-			while (inc > 0) {
-				--inc;
-				++sel;
+	//rebuild the state at key, replaying steps from its nearest cached ancestor (or from the root):
+	auto materialize = [&states,&root,&root_key](Key key, StateCache &cache, SearchStats &stats) -> UnrollState const & {
+		std::vector< UnrollStep const * > chain;
+		UnrollState const *from = nullptr;
+		Key at = key;
+		while (!(from = cache.find(at))) {
+			if (at == root_key) {
+				from = &root;
+				break;
 			}
-*/
+			UnrollStep const *step = states.find(at);
+			assert(step);
+			chain.emplace_back(step);
+			at = step->source_key;
+		}
+		if (chain.empty()) return *from;
 
-/*
-		//(JIM sez: this works okay -- some variation and then it latches on to a solution)
-		//anything from a range of reasonably good things:
-			std::vector< decltype(sel) > possible;
-			possible.emplace_back(sel);
-			auto max = sel->first + 0.1; //set to something larger than 0.0 for a bit of wiggle. These are source areas.
-			while (1) {
-				++sel;
-				if (sel == to_expand.end()) break;
-				if (sel->first > max) break;
-				possible.emplace_back(sel);
-			}
-			sel = possible[mt() % possible.size()];
-*/
+		UnrollState state = *from;
+		for (auto s = chain.rbegin(); s != chain.rend(); ++s) {
+			(*s)->apply(state);
+		}
+		++stats.rebuilt;
+		stats.replayed += chain.size();
+		return cache.add(key, std::move(state));
+	};
 
-		//(JIM sez: I like this one)
-		//take the next thing with exponentially-decaying chances:
-			while(1) {
-				auto next = sel;
-				++next;
-				if (next == to_expand.end()) break;
-				if (mt() < mt.max() / 3) break;
-				sel = next;
-			}
+	//expand one state, returning the new states to add to the frontier:
+	auto expand = [&](uint32_t w, Key key) {
+		SearchStats &my_stats = stats[w];
+		++my_stats.expanded;
 
-//-----=     E N D      =------
+		std::vector< std::pair< ExpandValue, Key > > fresh;
 
-			key = sel->second;
-			to_expand.erase(sel);
-		}
-		++stats.expanded;
+		UnrollState const &us = materialize(key, workers[w].cache, my_stats);
 
-		assert(states.count(key));
-		UnrollState const &us = states.find(key)->second;
+		if (us.active_edges.empty()) return fresh; //should have been report'd already?
 
-		if (us.active_edges.empty()) continue; //should have been report'd already?
+		std::vector< K::Segment_2 > active_segments;
+		active_segments.reserve(us.active_edges.size());
+		for (auto const &ae : us.active_edges) {
+			active_segments.emplace_back(ae.a, ae.b);
+		}
+		SegmentGrid active_grid(active_segments);
 
-		std::unordered_map< Key, UnrollState > fresh_states;
+		std::unordered_map< Key, UnrollStep > fresh_states;
 
 		//*check* that state is free along all edges, but only expand along *one* edge
 		ActiveEdge const *expand_edge = &(us.active_edges[0]);
@@ -974,10 +1250,6 @@ int main(int argc, char **argv) {
 			K::Vector_2 to_out = to_dir.perpendicular(CGAL::COUNTERCLOCKWISE);
 			if (!ae.perp_is_out) to_out = -to_out;
 
-			CGAL::Gmpq len2 = to_dir * to_dir;
-			assert(len2 > 0);
-			assert(len2 == to_out * to_out);
-
 			bool expanded = false;
 
 			if (edge.a != -1U) {
@@ -985,14 +1257,15 @@ int main(int argc, char **argv) {
 				assert(edge.a < faces.size());
 				auto const &face = faces[edge.a];
 				assert(edge.ae < face.boundary.size());
-				K::Point_2 const &a = face.boundary[edge.ae];
-				K::Point_2 const &b = face.boundary[(edge.ae+1)%face.boundary.size()];
-				K::Vector_2 dir = b-a;
-				K::Vector_2 out = dir.perpendicular(CGAL::COUNTERCLOCKWISE); //always move inside of 'a' to out direction
+				uint32_t k = geometry.face_begin[edge.a] + edge.ae;
+				K::Point_2 const &a = geometry.corner[k];
+				K::Point_2 const &b = geometry.corner[geometry.next(edge.a, k)];
+				K::Vector_2 const &dir = geometry.along[k];
+				K::Vector_2 const &out = geometry.inward[k]; //always move inside of 'a' to out direction
 
 				K::Vector_2 xf[3];
-				xf[0] = (to_dir * dir.x() + to_out * out.x()) / len2;
-				xf[1] = (to_dir * dir.y() + to_out * out.y()) / len2;
+				xf[0] = (to_dir * dir.x() + to_out * out.x()) * geometry.inv_len2[k];
+				xf[1] = (to_dir * dir.y() + to_out * out.y()) * geometry.inv_len2[k];
 				assert(xf[0] * xf[0] == 1);
 				assert(xf[1] * xf[1] == 1);
 				xf[2] = (ae.a - CGAL::ORIGIN) - (xf[0] * a.x() + xf[1] * a.y());
@@ -1001,7 +1274,7 @@ int main(int argc, char **argv) {
 				assert(CGAL::ORIGIN + xf[0] * b.x() + xf[1] * b.y() + xf[2] == ae.b);
 				assert(CGAL::ORIGIN + xf[0] * (b + out).x() + xf[1] * (b + out).y() + xf[2] == ae.b + to_out);
 
-				if (try_adding_face(key, us, edge.a, xf, target)) {
+				if (try_adding_face(key, us, active_grid, edge.a, xf, target, my_stats)) {
 					expanded = true;
 				}
 			}
@@ -1010,14 +1283,16 @@ int main(int argc, char **argv) {
 				assert(edge.b < faces.size());
 				auto const &face = faces[edge.b];
 				assert(edge.be < face.boundary.size());
-				K::Point_2 const &a = face.boundary[(edge.be+1)%face.boundary.size()];
-				K::Point_2 const &b = face.boundary[edge.be];
-				K::Vector_2 dir = b-a;
-				K::Vector_2 out = dir.perpendicular(CGAL::CLOCKWISE); //always move inside of 'b' to out direction
+				//(this runs along b's edge backwards, so dir is -along)
+				uint32_t k = geometry.face_begin[edge.b] + edge.be;
+				K::Point_2 const &a = geometry.corner[geometry.next(edge.b, k)];
+				K::Point_2 const &b = geometry.corner[k];
+				K::Vector_2 const &back = geometry.along[k];
+				K::Vector_2 const &out = geometry.inward[k]; //always move inside of 'b' to out direction
 
 				K::Vector_2 xf[3];
-				xf[0] = (to_dir * dir.x() + to_out * out.x()) / len2;
-				xf[1] = (to_dir * dir.y() + to_out * out.y()) / len2;
+				xf[0] = (to_out * out.x() - to_dir * back.x()) * geometry.inv_len2[k];
+				xf[1] = (to_out * out.y() - to_dir * back.y()) * geometry.inv_len2[k];
 				assert(xf[0] * xf[0] == 1);
 				assert(xf[1] * xf[1] == 1);
 				xf[2] = (ae.a - CGAL::ORIGIN) - (xf[0] * a.x() + xf[1] * a.y());
@@ -1026,24 +1301,117 @@ int main(int argc, char **argv) {
 				assert(CGAL::ORIGIN + xf[0] * b.x() + xf[1] * b.y() + xf[2] == ae.b);
 				assert(CGAL::ORIGIN + xf[0] * (b + out).x() + xf[1] * (b + out).y() + xf[2] == ae.b + to_out);
 
-				if (try_adding_face(key, us, edge.b, xf, target)) {
+				if (try_adding_face(key, us, active_grid, edge.b, xf, target, my_stats)) {
 					expanded = true;
 				}
 			}
 
 			if (!expanded) {
-				++stats.dead_ends;
+				++my_stats.dead_ends;
 				fresh_states.clear();
 				break;
 			}
 		}
 		for (auto const &kv : fresh_states) {
-			states.insert(kv);
-			to_expand.insert(std::make_pair(get_expand_value(kv.second), kv.first));
+			//(another thread may have found the same state in the meantime)
+			if (states.insert(kv.first, kv.second).second) {
+				fresh.emplace_back(get_expand_value(kv.second), kv.first);
+			}
+		}
+		return fresh;
+	};
+
+	//take up to half of (the best part of) another thread's frontier:
+	auto steal = [&](uint32_t w, Key *key) -> bool {
+		for (uint32_t i = 1; i < threads; ++i) {
+			Worker &victim = workers[(w + i) % threads];
+			std::vector< std::pair< ExpandValue, Key > > taken;
+			{
+				std::lock_guard< std::mutex > lock(victim.mutex);
+				size_t count = std::min< size_t >((victim.frontier.size() + 1) / 2, 64);
+				for (size_t t = 0; t < count; ++t) {
+					ExpandValue value = victim.frontier.min_value();
+					taken.emplace_back(value, victim.frontier.pop_min());
+				}
+			}
+			if (taken.empty()) continue;
+			*key = taken[0].second;
+			taken.erase(taken.begin());
+			std::lock_guard< std::mutex > lock(workers[w].mutex);
+			workers[w].frontier.push(taken);
+			return true;
+		}
+		return false;
+	};
+
+	std::atomic< uint32_t > expansions(0);
+	std::mutex dump_mutex;
+	auto work = [&](uint32_t w) {
+		Worker &me = workers[w];
+		while (!stop) {
+			Key key = 0;
+			bool have = false;
+			{
+				std::lock_guard< std::mutex > lock(me.mutex);
+				if (!me.frontier.empty()) {
+//-----= RANDOMIZATION SPOT =------
+
+/*
+			//(JIM sez: this seems like a pessimal option)
+			//Simple, fully random, expansion order:
+			// --> this makes things a *lot* slower
+			key = me.frontier.pop_rank(me.mt() % me.frontier.size());
+*/
+
+		//(JIM sez: I like this one)
+		//take the next thing with exponentially-decaying chances:
+			//(rank r is picked with chance (1/3)(2/3)^r; capped because walking to rank r costs O(r log r))
+			std::geometric_distribution< uint32_t > decay(1.0 / 3.0);
+			key = me.frontier.pop_rank(std::min(decay(me.mt), 64U));
+
+//-----=     E N D      =------
+					have = true;
+				}
+			}
+			if (!have) have = steal(w, &key);
+			if (!have) {
+				if (pending == 0) break; //nothing left anywhere
+				std::this_thread::yield();
+				continue;
+			}
+
+			if (++expansions % 1000 == 0) {
+				std::lock_guard< std::mutex > lock(dump_mutex);
+				dump_stats();
+			}
+
+			auto fresh = expand(w, key);
+			pending += fresh.size(); //(counted before anyone can steal them)
+			if (!fresh.empty()) {
+				std::lock_guard< std::mutex > lock(me.mutex);
+				me.frontier.push(fresh);
+			}
+			--pending;
 		}
+	};
+
+	if (!stop) {
+		std::vector< std::thread > helpers;
+		for (uint32_t w = 1; w < threads; ++w) {
+			helpers.emplace_back(work, w);
+		}
+		work(0);
+		for (auto &t : helpers) {
+			t.join();
+		}
+	}
+
+	if (found) {
+		report(*found);
+		return 0;
 	}
 
-	stats.dump();
+	dump_stats();
 
 	std::cerr << "ERROR: shouldn't have finished [" << prob_name << "] without solving." << std::endl;
 	return 1; //this *should* be complete, so it's weird.
@@ -0,0 +1,189 @@
+#include "sequence.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+void FoldSequence::fold(K::Point_2 const &a, K::Point_2 const &b) {
+	assert(a != b);
+	lines.emplace_back(a, b);
+}
+
+void FoldSequence::clear() {
+	lines.clear();
+	stages.clear();
+	bounds.clear();
+}
+
+K::Point_2 FoldSequence::land(K::Point_2 const &p) const {
+	K::Point_2 at = p;
+	for (auto const &f : lines) {
+		K::Vector_2 along = f.second - f.first;
+		K::Vector_2 perp(-along.y(), along.x());
+		if (perp * (at - f.first) > 0) {
+			K::Vector_2 flip_xf[3];
+			reflection_xf(f.first, f.second, flip_xf);
+			at = apply_xf(flip_xf, at);
+		}
+	}
+	return at;
+}
+
+static bool inside_convex(std::vector< K::Point_2 > const &poly, K::Point_2 const &q) {
+	for (uint32_t i = 0; i < poly.size(); ++i) {
+		if (CGAL::orientation(poly[i], poly[(i+1)%poly.size()], q) == CGAL::CLOCKWISE) return false;
+	}
+	return true;
+}
+
+std::vector< K::Point_2 > FoldSequence::preimages(K::Point_2 const &q) const {
+	outline(); //make sure stages are computed
+
+	auto on_paper = [this](uint32_t stage, K::Point_2 const &p) {
+		for (auto const &piece : stages[stage]) {
+			if (inside_convex(piece, p)) return true;
+		}
+		return false;
+	};
+
+	std::vector< K::Point_2 > at;
+	if (on_paper(lines.size(), q)) at.emplace_back(q);
+
+	//undo folds one at a time: a point on the kept side came from itself or from its mirror image;
+	// nothing lands on the flipped side:
+	for (uint32_t i = lines.size() - 1; i < lines.size(); --i) {
+		auto const &f = lines[i];
+		K::Vector_2 along = f.second - f.first;
+		K::Vector_2 perp(-along.y(), along.x());
+		K::Vector_2 flip_xf[3];
+		reflection_xf(f.first, f.second, flip_xf);
+
+		std::vector< K::Point_2 > before;
+		for (auto const &p : at) {
+			CGAL::Gmpq amt = perp * (p - f.first);
+			if (amt > 0) continue;
+			if (on_paper(i, p)) before.emplace_back(p);
+			if (amt == 0) continue; //on the crease, its mirror image is itself
+			K::Point_2 m = apply_xf(flip_xf, p);
+			if (on_paper(i, m)) before.emplace_back(m);
+		}
+		at = std::move(before);
+	}
+	return at;
+}
+
+std::vector< std::vector< K::Point_2 > > const &FoldSequence::outline() const {
+	if (stages.empty()) {
+		stages.emplace_back();
+		stages.back().emplace_back();
+		auto &square = stages.back().back();
+		square.emplace_back(0,0);
+		square.emplace_back(1,0);
+		square.emplace_back(1,1);
+		square.emplace_back(0,1);
+		bounds.emplace_back(K::Point_2(0,0), K::Point_2(1,1));
+	}
+
+	//pieces are stored ccw, starting at their lexicographically smallest corner, so equal pieces compare equal:
+	auto canonical = [](std::vector< K::Point_2 > &piece) {
+		auto min = std::min_element(piece.begin(), piece.end(), [](K::Point_2 const &x, K::Point_2 const &y) {
+			return x.x() < y.x() || (x.x() == y.x() && x.y() < y.y());
+		});
+		std::rotate(piece.begin(), min, piece.end());
+	};
+
+	while (stages.size() <= lines.size()) {
+		auto const &f = lines[stages.size() - 1];
+		K::Vector_2 along = f.second - f.first;
+		K::Vector_2 perp(-along.y(), along.x());
+		K::Vector_2 flip_xf[3];
+		reflection_xf(f.first, f.second, flip_xf);
+
+		std::vector< std::vector< K::Point_2 > > next;
+		std::unordered_multimap< size_t, uint32_t > seen;
+		auto add = [&](std::vector< K::Point_2 > &&piece, bool mirrored) {
+			assert(piece.size() >= 3);
+			if (mirrored) {
+				for (auto &p : piece) {
+					p = apply_xf(flip_xf, p);
+				}
+				std::reverse(piece.begin(), piece.end()); //mirroring turned it cw
+			}
+			canonical(piece);
+			size_t hash = piece.size();
+			for (auto const &p : piece) {
+				hash = hash_combine(hash, PointHash()(p));
+			}
+			auto range = seen.equal_range(hash);
+			for (auto i = range.first; i != range.second; ++i) {
+				if (next[i->second] == piece) return;
+			}
+			seen.insert(std::make_pair(hash, next.size()));
+			next.emplace_back(std::move(piece));
+		};
+
+		std::vector< ClipCorner > flip_corners, keep_corners;
+		for (auto const &piece : stages.back()) {
+			std::vector< CGAL::Gmpq > amt;
+			for (auto const &p : piece) {
+				amt.emplace_back(perp * (p - f.first));
+			}
+			LineSide side = line_side(amt.data(), piece.size());
+			if (side == KeepSide) {
+				add(std::vector< K::Point_2 >(piece), false);
+			} else if (side == FlipSide) {
+				add(std::vector< K::Point_2 >(piece), true);
+			} else {
+				clip_convex(amt.data(), piece.size(), &flip_corners, &keep_corners);
+				auto corners = [&piece](std::vector< ClipCorner > const &list) {
+					std::vector< K::Point_2 > ret;
+					ret.reserve(list.size());
+					for (auto const &c : list) {
+						K::Point_2 const &p = piece[c.k];
+						if (!c.crossing) ret.emplace_back(p);
+						else ret.emplace_back(p + (piece[(c.k + 1) % piece.size()] - p) * c.t);
+					}
+					return ret;
+				};
+				add(corners(flip_corners), true);
+				add(corners(keep_corners), false);
+			}
+		}
+
+		CGAL::Gmpq min_x = next[0][0].x();
+		CGAL::Gmpq min_y = next[0][0].y();
+		CGAL::Gmpq max_x = min_x;
+		CGAL::Gmpq max_y = min_y;
+		for (auto const &piece : next) {
+			for (auto const &p : piece) {
+				if (p.x() < min_x) min_x = p.x();
+				if (p.y() < min_y) min_y = p.y();
+				if (p.x() > max_x) max_x = p.x();
+				if (p.y() > max_y) max_y = p.y();
+			}
+		}
+		bounds.emplace_back(K::Point_2(min_x, min_y), K::Point_2(max_x, max_y));
+
+		stages.emplace_back(std::move(next));
+	}
+	return stages[lines.size()];
+}
+
+void FoldSequence::bbox(K::Point_2 *min, K::Point_2 *max) const {
+	outline(); //make sure bounds are computed
+	*min = bounds[lines.size()].first;
+	*max = bounds[lines.size()].second;
+}
+
+State FoldSequence::materialize() const {
+	State state;
+	state.emplace_back();
+	state.back().source.emplace_back(0,0);
+	state.back().source.emplace_back(1,0);
+	state.back().source.emplace_back(1,1);
+	state.back().source.emplace_back(0,1);
+	state.back().compute_xf(state.back().source);
+	for (auto const &f : lines) {
+		state.fold_dest(f.first, f.second);
+	}
+	return state;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "utils.hpp"
+#include "folders.hpp"
+
+#include <vector>
+#include <iostream>
+
+//Folded state stored implicitly as the unit square plus the fold lines applied to it (in order).
+//Questions about the folded state are answered by walking the folds, so a candidate fold
+// program can be evaluated without building every intermediate facet list;
+// facets are only built by materialize() (and so print_solution).
+//Each fold(a,b) behaves as State::fold_dest(a,b) would.
+struct FoldSequence {
+	//fold() and clear() are the only changes (they keep the cached outline stages in step):
+	void fold(K::Point_2 const &a, K::Point_2 const &b);
+	void clear();
+	std::vector< std::pair< K::Point_2, K::Point_2 > > const &folds() const { return lines; }
+
+	//where source point p lands after all the folds:
+	K::Point_2 land(K::Point_2 const &p) const;
+	//source points (in the unit square) that land on q; one per layer of paper covering q:
+	std::vector< K::Point_2 > preimages(K::Point_2 const &q) const;
+
+	//distinct convex pieces of the folded outline (stacked layers appear once), ccw:
+	std::vector< std::vector< K::Point_2 > > const &outline() const;
+	//bounding box of the folded paper (cached alongside the outline, so cheap to ask repeatedly):
+	void bbox(K::Point_2 *min, K::Point_2 *max) const;
+
+	State materialize() const;
+	void print_solution(std::ostream& out) const { materialize().print_solution(out); }
+
+private:
+	std::vector< std::pair< K::Point_2, K::Point_2 > > lines;
+	//outline pieces after each prefix of the folds (extended as needed by outline(),
+	// and used by preimages() to discard candidates that aren't on the paper):
+	mutable std::vector< std::vector< std::vector< K::Point_2 > > > stages;
+	//(min, max) corners of each stage's outline:
+	mutable std::vector< std::pair< K::Point_2, K::Point_2 > > bounds;
+};
@@ -28,6 +28,11 @@ CGAL::Polygon_set_2< K > Problem::get_silhouette() const {
 
 
 std::unique_ptr< Problem > Problem::read(std::string const &filename) {
+	std::ifstream file(filename);
+	return read(file, filename);
+}
+
+std::unique_ptr< Problem > Problem::read(std::istream &file, std::string const &filename) {
 	#define ERROR( X ) \
 		do { \
 			std::cerr << "ERROR reading problem file '" << filename << "': " << X << std::endl; \
@@ -35,7 +40,6 @@ std::unique_ptr< Problem > Problem::read(std::string const &filename) {
 		} while(0)
 
 	std::unique_ptr< Problem > ret(new Problem);
-	std::ifstream file(filename);
 	uint_fast32_t poly_count = 0;
 	if (!(file >> poly_count)) {
 		ERROR("failed to read polygon count.");
@@ -277,13 +281,17 @@ bool Solution::is_valid() const {
 }
 
 std::unique_ptr< Solution > Solution::read(std::string const &filename) {
+	std::ifstream file(filename);
+	return read(file, filename);
+}
+
+std::unique_ptr< Solution > Solution::read(std::istream &file, std::string const &filename) {
 	#define ERROR( X ) \
 		do { \
 			std::cerr << "ERROR reading solution file '" << filename << "': " << X << std::endl; \
 			return std::unique_ptr< Solution >(); \
 		} while(0)
 	std::unique_ptr< Solution > ret(new Solution);
-	std::ifstream file(filename);
 	uint_fast32_t vert_count = 0;
 	if (!(file >> vert_count)) {
 		ERROR("failed to read vertex count.");
@@ -13,6 +13,8 @@ struct Problem {
 	CGAL::Polygon_set_2< K > get_silhouette() const;
 
 	static std::unique_ptr< Problem > read(std::string const &filename);
+	//filename is only used for error messages:
+	static std::unique_ptr< Problem > read(std::istream &file, std::string const &filename);
 
         K::FT get_score (const CGAL::Polygon_with_holes_2<K>&) const;
         K::FT get_score (const CGAL::Polygon_set_2<K>&) const;
@@ -28,4 +30,6 @@ struct Solution {
 
 	bool is_valid() const;
 	static std::unique_ptr< Solution > read(std::string const &filename);
+	//filename is only used for error messages:
+	static std::unique_ptr< Solution > read(std::istream &file, std::string const &filename);
 };
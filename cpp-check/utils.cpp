@@ -28,6 +28,63 @@ K::FT polygon_set_area (CGAL::Polygon_set_2< K > const &ps) {
 	return ret;
 }
 
+void reflection_xf(K::Point_2 const &a, K::Point_2 const &b, K::Vector_2 (&xf)[3]) {
+	assert(a != b);
+	K::Vector_2 along = b - a;
+	K::Vector_2 perp(-along.y(), along.x());
+	auto len2 = along * along;
+	xf[0] = K::Vector_2(
+		along.x() * along.x() + -perp.x() * perp.x(),
+		along.y() * along.x() + -perp.y() * perp.x()
+		) / len2;
+	xf[1] = K::Vector_2(
+		along.x() * along.y() + -perp.x() * perp.y(),
+		along.y() * along.y() + -perp.y() * perp.y()
+		) / len2;
+	xf[2] = p2v(a) - (xf[0] * a.x() + xf[1] * a.y());
+
+	assert(apply_xf(xf, b + perp) == b - perp);
+}
+
+void compose_xf(K::Vector_2 const (&a)[3], K::Vector_2 const (&b)[3], K::Vector_2 (&out)[3]) {
+	K::Vector_2 ret[3];
+	ret[0] = a[0] * b[0].x() + a[1] * b[0].y();
+	ret[1] = a[0] * b[1].x() + a[1] * b[1].y();
+	ret[2] = a[0] * b[2].x() + a[1] * b[2].y() + a[2];
+	out[0] = ret[0];
+	out[1] = ret[1];
+	out[2] = ret[2];
+}
+
+LineSide line_side(CGAL::Gmpq const *amt, uint32_t n) {
+	bool any_flip = false;
+	bool any_keep = false;
+	for (uint32_t k = 0; k < n; ++k) {
+		if (amt[k] > 0) any_flip = true;
+		if (amt[k] < 0) any_keep = true;
+	}
+	assert((any_flip || any_keep) && "polygon shouldn't have zero area");
+	if (!any_flip) return KeepSide;
+	if (!any_keep) return FlipSide;
+	return BothSides;
+}
+
+void clip_convex(CGAL::Gmpq const *amt, uint32_t n, std::vector< ClipCorner > *flip, std::vector< ClipCorner > *keep) {
+	flip->clear();
+	keep->clear();
+	for (uint32_t k = 0; k < n; ++k) {
+		if (amt[k] >= 0) flip->emplace_back(ClipCorner{k, false, 0});
+		if (amt[k] <= 0) keep->emplace_back(ClipCorner{k, false, 0});
+		CGAL::Gmpq t;
+		if (line_crossing(amt[k], amt[(k + 1) % n], &t)) {
+			flip->emplace_back(ClipCorner{k, true, t});
+			keep->emplace_back(ClipCorner{k, true, t});
+		}
+	}
+	assert(flip->size() >= 3);
+	assert(keep->size() >= 3);
+}
+
 std::pair<bool, CGAL::Vector_2<K>> pythagorean_unit_approx (CGAL::Vector_2< K > const &vec) {
 	CGAL::Gmpq len2 = vec * vec;
 	CGAL::Gmpz scaled_len2 = len2.numerator() * len2.denominator();
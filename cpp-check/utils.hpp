@@ -33,6 +33,81 @@ inline void insert_square (const K::Vector_2 &x, const K::Point_2 &min, OutputIt
 	*(out++) = min_point+y;
 }
 
+//true if the (simple) polygon turns the same way at every vertex:
+inline bool is_convex(std::vector< K::Point_2 > const &poly) {
+	int32_t turn = 0;
+	for (uint32_t i = 0; i < poly.size(); ++i) {
+		auto const &a = poly[i];
+		auto const &b = poly[(i+1)%poly.size()];
+		auto const &c = poly[(i+2)%poly.size()];
+		auto o = CGAL::orientation(a, b, c);
+		if (o == CGAL::COLLINEAR) continue;
+		int32_t t = (o == CGAL::COUNTERCLOCKWISE ? 1 : -1);
+		if (turn == 0) turn = t;
+		if (turn != t) return false;
+	}
+	return true;
+}
+
+//hashing for exact coordinates (cheaper than formatting them into strings):
+inline size_t hash_combine(size_t seed, size_t v) {
+	return seed ^ (v + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+inline size_t hash_mpz(mpz_srcptr z) {
+	size_t ret = size_t(mpz_sgn(z) + 1);
+	for (size_t i = 0; i < mpz_size(z); ++i) {
+		ret = hash_combine(ret, size_t(mpz_getlimbn(z, i)));
+	}
+	return ret;
+}
+
+inline size_t hash_gmpq(CGAL::Gmpq const &q) {
+	return hash_combine(hash_mpz(mpq_numref(q.mpq())), hash_mpz(mpq_denref(q.mpq())));
+}
+
+struct PointHash {
+	size_t operator()(K::Point_2 const &pt) const {
+		return hash_combine(hash_gmpq(pt.x()), hash_gmpq(pt.y()));
+	}
+};
+
+//transforms are 2x3 (column major) matrices, p -> xf[0] * p.x() + xf[1] * p.y() + xf[2]:
+inline K::Point_2 apply_xf(K::Vector_2 const (&xf)[3], K::Point_2 const &p) {
+	return CGAL::ORIGIN + xf[0] * p.x() + xf[1] * p.y() + xf[2];
+}
+
+//reflection over the line through a and b:
+void reflection_xf(K::Point_2 const &a, K::Point_2 const &b, K::Vector_2 (&xf)[3]);
+//out = a after b (out may alias a or b):
+void compose_xf(K::Vector_2 const (&a)[3], K::Vector_2 const (&b)[3], K::Vector_2 (&out)[3]);
+
+//splitting polygons by a fold line, given each corner's signed (scaled) distance 'amt' from it;
+// positive is the side that gets flipped:
+enum LineSide {
+	KeepSide, //no corner on the flip side (includes corners on the line)
+	FlipSide, //no corner on the keep side
+	BothSides
+};
+LineSide line_side(CGAL::Gmpq const *amt, uint32_t n);
+//true (with t, the parameter along the edge) if the edge from a corner at amt0 to one at amt1 crosses the line:
+inline bool line_crossing(CGAL::Gmpq const &amt0, CGAL::Gmpq const &amt1, CGAL::Gmpq *t) {
+	if ((amt0 > 0 && amt1 < 0) || (amt0 < 0 && amt1 > 0)) {
+		*t = amt0 / (amt0 - amt1);
+		return true;
+	}
+	return false;
+}
+//a corner of a clipped piece: corner k, or the point t of the way along edge k -> k+1:
+struct ClipCorner {
+	uint32_t k;
+	bool crossing;
+	CGAL::Gmpq t;
+};
+//exact clip of a convex polygon crossing the line: walk the boundary, sending corners to their side
+// and crossing points (and corners on the line) to both:
+void clip_convex(CGAL::Gmpq const *amt, uint32_t n, std::vector< ClipCorner > *flip, std::vector< ClipCorner > *keep);
+
 K::FT polygon_with_holes_area (CGAL::Polygon_with_holes_2< K > const &pwh);
 K::FT polygon_set_area (CGAL::Polygon_set_2< K > const &ps);
 
@@ -0,0 +1,233 @@
+#include "validator.hpp"
+
+#include <algorithm>
+#include <memory>
+
+static std::pair< K::Point_2, K::Point_2 > edge_key(K::Point_2 const &a, K::Point_2 const &b) {
+	if (a.x() < b.x() || (a.x() == b.x() && a.y() < b.y())) return std::make_pair(a, b);
+	else return std::make_pair(b, a);
+}
+
+static bool on_boundary(std::pair< K::Point_2, K::Point_2 > const &e) {
+	return (e.first.x() == 0 && e.second.x() == 0)
+		|| (e.first.x() == 1 && e.second.x() == 1)
+		|| (e.first.y() == 0 && e.second.y() == 0)
+		|| (e.first.y() == 1 && e.second.y() == 1);
+}
+
+static CGAL::Gmpq area(std::vector< K::Point_2 > const &poly) {
+	CGAL::Gmpq ret = 0;
+	for (uint32_t i = 1; i + 1 < poly.size(); ++i) {
+		ret += K::Triangle_2(poly[0], poly[i], poly[i+1]).area();
+	}
+	return (ret < 0 ? -ret : ret);
+}
+
+//checks on a single facet's source polygon (in the square, simple); prints why and returns false if not:
+static bool check_source(Facet const &facet) {
+	auto const &src = facet.source;
+	if (src.size() < 3) {
+		std::cerr << "ERROR: facet has only " << src.size() << " vertices." << std::endl;
+		return false;
+	}
+	for (auto const &s : src) {
+		if (s.x() < 0 || s.x() > 1 || s.y() < 0 || s.y() > 1) {
+			std::cerr << "ERROR: source vertex " << s << " is outside the unit square." << std::endl;
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < src.size(); ++i) {
+		K::Segment_2 seg(src[i], src[(i+1)%src.size()]);
+		if (seg.source() == seg.target()) {
+			std::cerr << "ERROR: facet has zero-length edge at " << seg.source() << "." << std::endl;
+			return false;
+		}
+		for (uint32_t i2 = i + 1; i2 < src.size(); ++i2) {
+			K::Segment_2 seg2(src[i2], src[(i2+1)%src.size()]);
+			auto res = intersection(seg, seg2);
+			if (i2 == i + 1 || (i2 + 1) % src.size() == i) {
+				if (!(res && boost::get< K::Point_2 >(&*res))) {
+					std::cerr << "ERROR: adjacent edges of facet don't intersect in a point." << std::endl;
+					return false;
+				}
+			} else if (res) {
+				std::cerr << "ERROR: non-adjacent edges of facet intersect." << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//the transform must be rigid: orthonormal columns, with the determinant's sign matching 'flipped':
+static bool check_xf(Facet const &facet) {
+	auto const &xf = facet.xf;
+	CGAL::Gmpq det = xf[0].x() * xf[1].y() - xf[0].y() * xf[1].x();
+	if (xf[0] * xf[0] != 1 || xf[1] * xf[1] != 1 || xf[0] * xf[1] != 0 || det != (facet.flipped ? -1 : 1)) {
+		std::cerr << "ERROR: facet's transform isn't a " << (facet.flipped ? "mirrored" : "unmirrored") << " congruence." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool StateValidator::reset(State const &state) {
+	ok = false;
+	folds = 0;
+	checked = 0;
+	source_area = 0;
+	edge_uses.clear();
+
+	//the full check is Solution::is_valid:
+	Solution solution;
+	std::unordered_map< K::Point_2, uint32_t, PointHash > vertex_idx;
+	std::vector< K::Point_2 > destination;
+	for (auto const &facet : state) {
+		facet.destination(&destination);
+		solution.facets.emplace_back();
+		for (uint32_t i = 0; i < facet.source.size(); ++i) {
+			auto ret = vertex_idx.insert(std::make_pair(facet.source[i], uint32_t(solution.source.size())));
+			if (ret.second) {
+				solution.source.emplace_back(facet.source[i]);
+				solution.destination.emplace_back(destination[i]);
+			} else if (solution.destination[ret.first->second] != destination[i]) {
+				std::cerr << "ERROR: facets sharing source vertex " << facet.source[i] << " put it in different places." << std::endl;
+				return false;
+			}
+			solution.facets.back().emplace_back(ret.first->second);
+		}
+	}
+	if (!solution.is_valid()) return false;
+
+	for (auto const &facet : state) {
+		if (!check_source(facet) || !check_xf(facet)) return false;
+		source_area += area(facet.source);
+		for (uint32_t i = 0; i < facet.source.size(); ++i) {
+			edge_uses[edge_key(facet.source[i], facet.source[(i+1)%facet.source.size()])] += 1;
+		}
+	}
+	checked = state.size();
+	ok = true;
+	return true;
+}
+
+bool StateValidator::fold(std::vector< Facet const * > const &facets, State const &pieces, std::vector< uint32_t > const &origin) {
+	assert(pieces.size() == origin.size());
+	if (!ok) return false; //(already failed, or never reset)
+	++folds;
+	ok = false; //(until the checks below pass)
+
+	//pieces of each facet (facets folded whole come out as one piece, with the same source):
+	std::vector< uint32_t > piece_begin(facets.size() + 1, 0);
+	for (uint32_t i = 0; i < origin.size(); ++i) {
+		assert(origin[i] < facets.size());
+		assert(i == 0 || origin[i - 1] <= origin[i]);
+		piece_begin[origin[i] + 1] += 1;
+	}
+	for (uint32_t f = 0; f < facets.size(); ++f) {
+		piece_begin[f + 1] += piece_begin[f];
+	}
+
+	std::vector< std::pair< K::Point_2, K::Point_2 > > touched;
+	for (uint32_t f = 0; f < facets.size(); ++f) {
+		uint32_t begin = piece_begin[f];
+		uint32_t end = piece_begin[f + 1];
+		if (end == begin) {
+			std::cerr << "ERROR: fold lost a facet." << std::endl;
+			return false;
+		}
+		if (end == begin + 1) {
+			//kept or mirrored whole; at most the transform is new:
+			Facet const &piece = pieces[begin];
+			if (piece.xf[0] != facets[f]->xf[0] || piece.xf[1] != facets[f]->xf[1] || piece.xf[2] != facets[f]->xf[2]) {
+				if (!check_xf(piece)) return false;
+				++checked;
+			}
+			continue;
+		}
+
+		//split: pieces must be valid facets that exactly cover the original...
+		Facet const &facet = *facets[f];
+		CGAL::Gmpq pieces_area = 0;
+		for (uint32_t p = begin; p < end; ++p) {
+			if (!check_source(pieces[p]) || !check_xf(pieces[p])) return false;
+			pieces_area += area(pieces[p].source);
+		}
+		checked += end - begin;
+		CGAL::Gmpq facet_area = area(facet.source);
+		if (pieces_area != facet_area) {
+			std::cerr << "ERROR: facet of area " << facet_area << " was split into pieces of total area " << pieces_area << "." << std::endl;
+			return false;
+		}
+		source_area += pieces_area - facet_area;
+
+		//...and only touch each other at shared corners or shared edges:
+		for (uint32_t p = begin; p < end; ++p) {
+			auto const &ps = pieces[p].source;
+			for (uint32_t q = p + 1; q < end; ++q) {
+				auto const &qs = pieces[q].source;
+				for (uint32_t i = 0; i < ps.size(); ++i) {
+					K::Segment_2 a(ps[i], ps[(i+1)%ps.size()]);
+					for (uint32_t j = 0; j < qs.size(); ++j) {
+						K::Segment_2 b(qs[j], qs[(j+1)%qs.size()]);
+						if (a.source() == b.target() && a.target() == b.source()) continue;
+						auto res = intersection(a, b);
+						if (!res) continue;
+						K::Point_2 const *pt = boost::get< K::Point_2 >(&*res);
+						if (pt && (*pt == a.source() || *pt == a.target()) && (*pt == b.source() || *pt == b.target())) continue;
+						std::cerr << "ERROR: pieces of a split facet cross at " << a << " / " << b << "." << std::endl;
+						return false;
+					}
+				}
+			}
+		}
+
+		//swap the facet's edges for the pieces' edges:
+		for (uint32_t i = 0; i < facet.source.size(); ++i) {
+			auto key = edge_key(facet.source[i], facet.source[(i+1)%facet.source.size()]);
+			auto e = edge_uses.find(key);
+			assert(e != edge_uses.end() && e->second > 0);
+			e->second -= 1;
+			touched.emplace_back(key);
+		}
+		for (uint32_t p = begin; p < end; ++p) {
+			auto const &ps = pieces[p].source;
+			for (uint32_t i = 0; i < ps.size(); ++i) {
+				auto key = edge_key(ps[i], ps[(i+1)%ps.size()]);
+				edge_uses[key] += 1;
+				touched.emplace_back(key);
+			}
+		}
+	}
+
+	//neighbours: every edge touched by a split is now either gone or shared properly:
+	for (auto const &key : touched) {
+		auto e = edge_uses.find(key);
+		if (e == edge_uses.end()) continue; //(touched more than once, and already found unused)
+		uint32_t uses = e->second;
+		if (uses == 0) {
+			edge_uses.erase(e);
+		} else if (!(uses == 2 || (uses == 1 && on_boundary(key)))) {
+			std::cerr << "ERROR: after fold, source edge " << key.first << " -- " << key.second << " is used by " << uses << " facets"
+				<< (uses == 1 ? " (a neighbour wasn't split to match)." : ".") << std::endl;
+			return false;
+		}
+	}
+	if (source_area != 1) {
+		std::cerr << "ERROR: facets have total area of " << source_area << " but a square would have area 1." << std::endl;
+		return false;
+	}
+
+	ok = true;
+	return true;
+}
+
+bool StateValidator::moved(State const &state) {
+	if (!ok) return false;
+	ok = false;
+	for (auto const &facet : state) {
+		if (!check_xf(facet)) return false;
+	}
+	checked += state.size();
+	ok = true;
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "folders.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+//Validity checking (the rules in Solution::is_valid) for a State as it is folded.
+//The starting state gets a full check; after that each fold only re-checks the facets it split:
+// the pieces must be simple, inside the square, rigidly moved, and cover exactly the facet they
+// came from (which keeps the running source area at 1). Neighbours aren't compared geometrically;
+// the only check between facets is a use count per source edge: every edge a split added or removed
+// must end up used by exactly two facets (one, on the square's boundary), so a neighbour that wasn't
+// split to match shows up as a lone edge. (Crossings are only tested among the pieces of one facet.)
+//Attach one to a State with State::validator; fold_dest and refold then report to it.
+//Copies of a State don't share its validator.
+struct StateValidator {
+	//full check of a starting state:
+	bool reset(State const &state);
+	//after a fold: pieces[i] came from facets[origin[i]]:
+	bool fold(std::vector< Facet const * > const &facets, State const &pieces, std::vector< uint32_t > const &origin);
+	//after refold / unfold (sources don't change, so only transforms are checked):
+	bool moved(State const &state);
+
+	bool ok = false; //set by reset, cleared by the first failed check
+	uint32_t folds = 0; //folds checked since reset
+	uint32_t checked = 0; //facets checked since reset
+	CGAL::Gmpq source_area = 0; //running total of facet areas
+
+	struct EdgeHash {
+		size_t operator()(std::pair< K::Point_2, K::Point_2 > const &e) const {
+			return hash_combine(PointHash()(e.first), PointHash()(e.second));
+		}
+	};
+	//source edges (lexicographically smaller end first) -> number of facets using them:
+	std::unordered_map< std::pair< K::Point_2, K::Point_2 >, uint32_t, EdgeHash > edge_uses;
+};
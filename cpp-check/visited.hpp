@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+//Lock-free insert-only hash table from 64-bit keys to values, for states shared between search threads.
+//Values are allocated once and never moved or removed, so pointers to them stay valid for the table's lifetime.
+//
+//Open addressing over a chain of levels (each twice the size of the last): a key's probe path is
+// a short run of slots in level 0, then a run in level 1, and so on. Slots only ever go from empty
+// to full, so every thread walking a key's path sees the same keys in the same order, and the key
+// can only be in the first slot of its path that was empty -- that's what makes insert-if-absent safe
+// without locks. Levels are allocated (with a compare-and-swap) the first time a path runs into them.
+template< typename VALUE >
+struct VisitedTable {
+	VisitedTable() {
+		for (auto &l : levels) {
+			l.store(nullptr, std::memory_order_relaxed);
+		}
+		zero_value.store(nullptr, std::memory_order_relaxed);
+	}
+	VisitedTable(VisitedTable const &) = delete;
+	VisitedTable &operator=(VisitedTable const &) = delete;
+	~VisitedTable() {
+		for (uint32_t l = 0; l < MaxLevels; ++l) {
+			Slot *slots = levels[l].load(std::memory_order_relaxed);
+			if (!slots) break;
+			for (uint64_t i = 0; i < level_size(l); ++i) {
+				delete slots[i].value.load(std::memory_order_relaxed);
+			}
+			delete[] slots;
+		}
+		delete zero_value.load(std::memory_order_relaxed);
+	}
+
+	//nullptr if key isn't present:
+	VALUE const *find(uint64_t key) const {
+		if (key == 0) return zero_value.load(std::memory_order_acquire);
+		for (uint32_t l = 0; l < MaxLevels; ++l) {
+			Slot *slots = levels[l].load(std::memory_order_acquire);
+			if (!slots) return nullptr;
+			uint64_t mask = level_size(l) - 1;
+			uint64_t at = mix(key, l) & mask;
+			for (uint32_t p = 0; p < Probes; ++p, at = (at + 1) & mask) {
+				uint64_t k = slots[at].key.load(std::memory_order_acquire);
+				if (k == 0) return nullptr;
+				if (k == key) return wait_for(slots[at]);
+			}
+		}
+		assert(0 && "ran out of levels");
+		return nullptr;
+	}
+
+	bool contains(uint64_t key) const {
+		return find(key) != nullptr;
+	}
+
+	//insert value under key unless key is already present; returns the stored value and whether this call stored it:
+	std::pair< VALUE const *, bool > insert(uint64_t key, VALUE const &value) {
+		if (key == 0) {
+			VALUE *had = zero_value.load(std::memory_order_acquire);
+			if (had) return std::pair< VALUE const *, bool >(had, false);
+			VALUE *made = new VALUE(value);
+			if (zero_value.compare_exchange_strong(had, made, std::memory_order_acq_rel)) {
+				count.fetch_add(1, std::memory_order_relaxed);
+				return std::pair< VALUE const *, bool >(made, true);
+			}
+			delete made;
+			return std::pair< VALUE const *, bool >(had, false);
+		}
+		VALUE *made = nullptr; //allocated at the first empty slot, and kept if that slot gets taken first
+		for (uint32_t l = 0; l < MaxLevels; ++l) {
+			Slot *slots = level(l);
+			uint64_t mask = level_size(l) - 1;
+			uint64_t at = mix(key, l) & mask;
+			for (uint32_t p = 0; p < Probes; ++p, at = (at + 1) & mask) {
+				uint64_t k = slots[at].key.load(std::memory_order_acquire);
+				if (k == 0) {
+					if (!made) made = new VALUE(value);
+					if (slots[at].key.compare_exchange_strong(k, key, std::memory_order_acq_rel)) {
+						slots[at].value.store(made, std::memory_order_release);
+						count.fetch_add(1, std::memory_order_relaxed);
+						return std::pair< VALUE const *, bool >(made, true);
+					}
+					//(k now holds whatever key got here first)
+				}
+				if (k == key) {
+					delete made;
+					return std::make_pair(wait_for(slots[at]), false);
+				}
+			}
+		}
+		assert(0 && "ran out of levels");
+		delete made;
+		return std::pair< VALUE const *, bool >(nullptr, false);
+	}
+
+	size_t size() const {
+		return count.load(std::memory_order_relaxed);
+	}
+
+private:
+	static constexpr uint32_t MaxLevels = 40;
+	static constexpr uint32_t FirstLevelBits = 12;
+	static constexpr uint32_t Probes = 16; //slots tried per level before moving on to the next
+
+	struct Slot {
+		std::atomic< uint64_t > key{0}; //0 means empty (key 0 itself lives in zero_value)
+		std::atomic< VALUE * > value{nullptr}; //set just after key is claimed
+	};
+
+	std::atomic< Slot * > levels[MaxLevels];
+	std::atomic< VALUE * > zero_value;
+	std::atomic< size_t > count{0};
+
+	static uint64_t level_size(uint32_t l) {
+		return uint64_t(1) << (FirstLevelBits + l);
+	}
+
+	//splitmix64 finalizer, salted per level so a crowded run in one level doesn't line up with the next:
+	static uint64_t mix(uint64_t key, uint32_t l) {
+		uint64_t x = key + 0x9e3779b97f4a7c15ULL * (l + 1);
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+
+	//level l, allocating it if no thread has yet:
+	Slot *level(uint32_t l) {
+		Slot *slots = levels[l].load(std::memory_order_acquire);
+		if (slots) return slots;
+		Slot *made = new Slot[level_size(l)];
+		if (levels[l].compare_exchange_strong(slots, made, std::memory_order_acq_rel)) {
+			return made;
+		}
+		delete[] made;
+		return slots;
+	}
+
+	//a claimed slot's value is published right after its key, so this wait is short:
+	static VALUE const *wait_for(Slot const &slot) {
+		VALUE const *v;
+		while (!(v = slot.value.load(std::memory_order_acquire))) {
+			std::this_thread::yield();
+		}
+		return v;
+	}
+};